@@ -3,14 +3,17 @@
 CFLAGS="-O2 -Wall -Wextra\
 	-Wno-format-truncation\
 	-fno-asynchronous-unwind-tables\
+	-pthread\
 	$(pkg-config --cflags ncursesw)"
 
-LDFLAGS="$(pkg-config --libs ncursesw)"
+LDFLAGS="-pthread $(pkg-config --libs ncursesw)"
 
 SOURCES="md5hash.c omnigame.c omnifunc.c omniload.c omnilua.c omnimem.c\
-	omninew.c omnidraw/omnidraw.c omnisave.c omnimino.c"
+	omninew.c omniread.c omnirow.c omnishape.c omnidraw/omnidraw.c omnisave.c"
 
-gcc $CFLAGS -o omnimino $SOURCES $LDFLAGS
+gcc $CFLAGS -o omnimino $SOURCES omnibatch.c omnicache.c omnigen.c omniplay.c omniscan.c omnisolve.c omnimino.c $LDFLAGS
+
+gcc $CFLAGS -o omnibench $SOURCES omnibench.c $LDFLAGS
 
 test -e omnifill || ln -s omnimino omnifill
 
@@ -1,18 +1,14 @@
 #include <stdint.h>
 #include <string.h>
 
+#include "md5hash.h"
+
 
 // ---------------------------------------------------------------------------
 // from musl/src/crypt/crypt_md5.c
 
 /* public domain md5 implementation based on rfc1321 and libtomcrypt */
 
-struct md5 {
-	uint64_t len;    /* processed message length */
-	uint32_t h[4];   /* hash state */
-	uint8_t buf[64]; /* message block buffer */
-};
-
 static uint32_t rol(uint32_t n, int k) { return (n << k) | (n >> (32-k)); }
 #define F(x,y,z) (z ^ (x & (y ^ z)))
 #define G(x,y,z) (y ^ (z & (y ^ x)))
@@ -149,24 +145,49 @@ static void md5_update(struct md5 *s, const void *m, unsigned long len)
 }
 
 
-#include "md5hash.h"
+static void md5hex(const unsigned char *hash, char *a)
+{
+	static char hex[16] = "0123456789abcdef";
+	int i;
+
+	for (i = 0; i < MD5HASH_SIZE; i++) {
+		*a++ = hex[hash[i] / 16];
+		*a++ = hex[hash[i] % 16];
+	}
+	*a = 0;
+}
 
 
 void md5hash(const void *buf, unsigned int len, char *a)
 {
-	static char hex[16] = "0123456789abcdef";
-
 	struct md5 ctx;
 	unsigned char hash[MD5HASH_SIZE];
-	int i;
 
 	md5_init(&ctx);
 	md5_update(&ctx, buf, len);
 	md5_sum(&ctx, hash);
 
-	for (i = 0; i < MD5HASH_SIZE; i++) {
-		*a++ = hex[hash[i] / 16];
-		*a++ = hex[hash[i] % 16];
-	}
-	*a = 0;
+	md5hex(hash, a);
+}
+
+
+void md5hash_init(struct md5 *s)
+{
+	md5_init(s);
+}
+
+
+void md5hash_update(struct md5 *s, const void *buf, unsigned long len)
+{
+	md5_update(s, buf, len);
+}
+
+
+void md5hash_final(struct md5 *s, char *a)
+{
+	unsigned char hash[MD5HASH_SIZE];
+
+	md5_sum(s, hash);
+
+	md5hex(hash, a);
 }
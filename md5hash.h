@@ -5,7 +5,21 @@
 #define MD5HASH_SIZE 16
 #define MD5HASH_LEN (2 * MD5HASH_SIZE)
 
+#include <stdint.h>
+
+struct md5 {
+	uint64_t len;    /* processed message length */
+	uint32_t h[4];   /* hash state */
+	uint8_t buf[64]; /* message block buffer */
+};
+
 void md5hash(const void *buf, unsigned int len, char *asciihash);
 
+/* the same hash of a buffer given in parts */
+
+void md5hash_init(struct md5 *s);
+void md5hash_update(struct md5 *s, const void *buf, unsigned long len);
+void md5hash_final(struct md5 *s, char *asciihash);
+
 #endif
 
@@ -106,7 +106,7 @@ Type	WMax	Goal	App	Metr	Grav	SL	DFR	GW	GH	FL	FR	WMin
 local Branch={}
 
 
-local pipe = io.popen("ls *.mino | " .. OmniminoName, "r")
+local pipe = io.popen(OmniminoName .. "-l -j 0 -c .omnimino.cache -d .", "r")
 local chunk = assert(pipe:read("a"))
 assert(pipe:close())
 local f = load("_G = nil _ENV = nil return {" .. chunk .. "}")
@@ -127,6 +127,47 @@ for i,B in ipairs(IBranch) do
   end
 end
 
+-------------------------------------------------------
+-- Games are replayed for scores once they are shown --
+-------------------------------------------------------
+
+local FetchScores = function(SBranch)
+  local Wanted = {}
+  local Num = 0
+  local ListName = os.tmpname()
+  local List = assert(io.open(ListName, "w"))
+
+  for i, Br in ipairs(SBranch) do
+    for j, D in ipairs(Br) do
+      if D[4] == nil then -- a game listed without its score
+        List:write(D[1], "\n")
+        Wanted[D[1]] = D
+        Num = Num + 1
+      end
+    end
+  end
+
+  List:close()
+
+  if Num > 0 then
+    local pipe = io.popen(OmniminoName .. "-j 0 -c .omnimino.cache < " .. ListName, "r")
+    local chunk = assert(pipe:read("a"))
+    pipe:close()
+    local f = load("_G = nil _ENV = nil return {" .. chunk .. "}")
+
+    if f then
+      for i, B in ipairs(f()) do
+        if Wanted[B.Data[1]] then
+          Wanted[B.Data[1]][4] = B.Data[4]
+        end
+      end
+    end
+  end
+
+  os.remove(ListName)
+end
+
+
 -------------------------------------------------
 -- Make filter keys of commannd-line arguments --
 -------------------------------------------------
@@ -291,6 +332,8 @@ repeat -----------------------------------------
 
   SBranch = SelectBranchesMatching(MakeKey(Ans))
 
+  FetchScores(SBranch)
+
   table.sort(SBranch, CompareBranches)
 
   ShowSortedBranches(SBranch)
@@ -0,0 +1,317 @@
+#define _GNU_SOURCE 1
+
+#include <features.h>
+
+#include <stdio.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "omnigame.h"
+#include "omniload.h"
+#include "omnilua.h"
+#include "omninew.h"
+#include "omnibatch.h"
+
+#define stringize(s) stringyze(s)
+#define stringyze(s) #s
+
+
+void Report(struct Omnimino *G, FILE *fout) {
+  if ((G->V.GameType != 3) && (G->D.LastFigure != G->M.Figure)) /* game data present */
+    snprintf(G->S.MsgBuf, OM_STRLEN,  "%d", GetScore(G));
+
+  if (isatty(fileno(stdout))) {
+    fprintf(fout, "%s\n", G->S.MsgBuf);
+  } else {
+    ExportLua(G, fout);
+  }
+}
+
+
+/* Scores 0 - games are not loaded past their headers, their scores are nil unless cached */
+
+static void ReplayFile(struct Omnimino *G, char *Name, FILE *fout, struct OmniCache *Cache, int Scores) {
+  struct stat st;
+  int Cached = (Cache != NULL) && (stat(Name, &st) == 0);
+
+  if (Cached && (FindCached(Cache, Name, &st, G) == 0)) {
+    Report(G, fout);
+    return;
+  }
+
+  if (!Scores) {
+    LoadHeader(G, Name);
+    Report(G, fout);
+    return;
+  }
+
+  if (LoadGame(G, Name) == 0) {
+    if (G->V.GameType == 1) {
+      G->V.CurFigure = G->D.NextFigure + 1;
+      GetGlassState(G);
+    }
+  }
+  Report(G, fout);
+
+  if (Cached)
+    StoreCached(Cache, &st, G);
+}
+
+
+/* from the scanned directories when List is given, from the listing in fin otherwise */
+
+static int ReadName(FILE *fin, struct NameList *List, char *FName) {
+  char *Path;
+
+  if (List) {
+    while ((Path = NextScanned(List)) != NULL) {
+      if (strlen(Path) <= PATH_MAX) {
+        strcpy(FName, Path);
+        return 1;
+      }
+      fprintf(stderr, "Path too long, skipped %s.\n", Path); /* not to be taken for another file */
+    }
+    return 0;
+  }
+
+  return fscanf(fin, "%" stringize(PATH_MAX) "s%*[^\n]", FName) > 0;
+}
+
+
+/**************************************
+
+         Parallel batch report
+
+**************************************/
+
+#define SLOTS_PER_JOB 16
+
+enum SlotStates {
+  SLOT_PENDING,
+  SLOT_DONE
+};
+
+struct BatchSlot {
+  char Name[PATH_MAX + 1];
+  char *Out;
+  size_t OutLen;
+  int State;
+};
+
+struct Batch {
+  pthread_mutex_t Lock;
+  pthread_cond_t Work;   /* new names queued or input exhausted */
+  pthread_cond_t Done;   /* some slot finished */
+  struct BatchSlot *Slot;
+  struct OmniCache *Cache;
+  int Scores;
+  unsigned int SlotNum;
+  unsigned long Head;    /* next to be written out */
+  unsigned long Take;    /* next to be replayed */
+  unsigned long Tail;    /* next to be read */
+  int Eof;
+};
+
+
+static void *BatchWorker(void *Arg) {
+  struct Batch *B = Arg;
+  struct BatchSlot *S;
+  struct Omnimino Game;
+  char FName[PATH_MAX + 1];
+  FILE *fout;
+  char *Out;
+  size_t OutLen;
+
+  InitGame(&Game);
+
+  pthread_mutex_lock(&B->Lock);
+
+  for (;;) {
+    while ((B->Take == B->Tail) && (!B->Eof))
+      pthread_cond_wait(&B->Work, &B->Lock);
+
+    if (B->Take == B->Tail)
+      break;
+
+    S = B->Slot + (B->Take++ % B->SlotNum);
+    strcpy(FName, S->Name);
+
+    pthread_mutex_unlock(&B->Lock);
+
+    Out = NULL;
+    OutLen = 0;
+    fout = open_memstream(&Out, &OutLen);
+    if (fout) {
+      ReplayFile(&Game, FName, fout, B->Cache, B->Scores);
+      fclose(fout);
+    }
+
+    pthread_mutex_lock(&B->Lock);
+
+    S->Out = Out;
+    S->OutLen = OutLen;
+    S->State = SLOT_DONE;
+    pthread_cond_broadcast(&B->Done);
+  }
+
+  pthread_mutex_unlock(&B->Lock);
+
+  free(Game.M.Figure);
+
+  return NULL;
+}
+
+
+static void ParallelReport(FILE *fin, struct NameList *List, unsigned int Jobs, struct OmniCache *Cache, int Scores) {
+  struct Batch B;
+  struct BatchSlot *S;
+  pthread_t *Worker;
+  unsigned int i, Started;
+  char FName[PATH_MAX + 1];
+
+  B.SlotNum = Jobs * SLOTS_PER_JOB;
+  B.Slot = calloc(B.SlotNum, sizeof(struct BatchSlot));
+  Worker = calloc(Jobs, sizeof(pthread_t));
+
+  if ((B.Slot == NULL) || (Worker == NULL)) {
+    free(B.Slot);
+    free(Worker);
+    fprintf(stderr, "Failed to allocate batch slots, running single job.\n");
+    BatchReport(fin, List, 1, Cache, Scores);
+    return;
+  }
+
+  pthread_mutex_init(&B.Lock, NULL);
+  pthread_cond_init(&B.Work, NULL);
+  pthread_cond_init(&B.Done, NULL);
+  B.Cache = Cache;
+  B.Scores = Scores;
+  B.Head = B.Take = B.Tail = 0;
+  B.Eof = 0;
+
+  for (Started = 0; Started < Jobs; Started++) {
+    if (pthread_create(Worker + Started, NULL, BatchWorker, &B) != 0)
+      break;
+  }
+
+  pthread_mutex_lock(&B.Lock);
+
+  while (Started > 0) {
+    while ((!B.Eof) && ((B.Tail - B.Head) < B.SlotNum)) {
+      pthread_mutex_unlock(&B.Lock);
+      i = ReadName(fin, List, FName);
+      pthread_mutex_lock(&B.Lock);
+      if (i == 0) {
+        B.Eof = 1;
+      } else {
+        S = B.Slot + (B.Tail++ % B.SlotNum);
+        strcpy(S->Name, FName);
+        S->State = SLOT_PENDING;
+      }
+      pthread_cond_broadcast(&B.Work);
+    }
+
+    if (B.Head == B.Tail)
+      break;
+
+    S = B.Slot + (B.Head % B.SlotNum);
+    while (S->State != SLOT_DONE)
+      pthread_cond_wait(&B.Done, &B.Lock);
+
+    pthread_mutex_unlock(&B.Lock);
+    fwrite(S->Out, 1, S->OutLen, stdout);
+    free(S->Out);
+    pthread_mutex_lock(&B.Lock);
+
+    B.Head++;
+  }
+
+  B.Eof = 1;
+  pthread_cond_broadcast(&B.Work);
+  pthread_mutex_unlock(&B.Lock);
+
+  for (i = 0; i < Started; i++)
+    pthread_join(Worker[i], NULL);
+
+  pthread_cond_destroy(&B.Done);
+  pthread_cond_destroy(&B.Work);
+  pthread_mutex_destroy(&B.Lock);
+
+  free(Worker);
+  free(B.Slot);
+
+  if (Started == 0) {
+    fprintf(stderr, "Failed to start batch workers, running single job.\n");
+    BatchReport(fin, List, 1, Cache, Scores);
+  }
+}
+
+
+/**************************************
+
+             BatchReport
+
+**************************************/
+
+void BatchReport(FILE *fin, struct NameList *List, unsigned int Jobs, struct OmniCache *Cache, int Scores) {
+  char FName[PATH_MAX + 1];
+  struct Omnimino Game;
+
+  if (Jobs == 0) {
+    long N = sysconf(_SC_NPROCESSORS_ONLN);
+    Jobs = (N > 0) ? N : 1;
+  }
+
+  if (Jobs > 1) {
+    ParallelReport(fin, List, Jobs, Cache, Scores);
+    return;
+  }
+
+  InitGame(&Game);
+
+  while (ReadName(fin, List, FName))
+    ReplayFile(&Game, FName, stdout, Cache, Scores);
+
+  free(Game.M.Figure);
+}
+
+
+
+/**************************************
+
+             VerifyFiles
+
+  Records are read BULK_WINDOW at once
+  with io_uring, or by Jobs threads if
+  it is missing, then checked as with
+  LoadHeader() one by one.
+
+**************************************/
+
+void VerifyFiles(char **Name, unsigned long Num, unsigned int Jobs, FILE *fout) {
+  struct BulkReader B;
+  struct Omnimino Game;
+  unsigned long i;
+  unsigned int k, n;
+
+  InitGame(&Game);
+  BulkInit(&B, Jobs);
+
+  for (i = 0; i < Num; i += n) {
+    n = ((Num - i) < BULK_WINDOW) ? (Num - i) : BULK_WINDOW;
+    BulkRead(&B, Name + i, n);
+
+    for (k = 0; k < n; k++) {
+      LoadBuffer(&Game, B.File + k, 0);
+      fprintf(fout, "%s %s\n", Name[i + k],
+              (Game.V.GameType == 3) ? Game.S.MsgBuf : ((Game.V.GameType == 1) ? "game" : "preset"));
+    }
+  }
+
+  BulkFree(&B);
+  free(Game.M.Figure);
+}
@@ -0,0 +1,16 @@
+#ifndef _OMNIBATCH_H
+
+#define _OMNIBATCH_H 1
+
+#include <stdio.h>
+
+#include "omnitype.h"
+#include "omnicache.h"
+#include "omniscan.h"
+
+void Report(struct Omnimino *G, FILE *fout);
+void VerifyFiles(char **Name, unsigned long Num, unsigned int Jobs, FILE *fout);
+void BatchReport(FILE *fin, struct NameList *List, unsigned int Jobs, struct OmniCache *Cache, int Scores);
+
+#endif
+
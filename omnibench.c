@@ -0,0 +1,374 @@
+#define _GNU_SOURCE 1
+
+#include <features.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <time.h>
+#include <glob.h>
+
+#include "omnifunc.h"
+#include "omnigame.h"
+#include "omniload.h"
+#include "omnisave.h"
+#include "omninew.h"
+#include "omnirow.h"
+
+#define USAGE "Usage: omnibench [-n rounds] [infile ...]\n\n"\
+              "Replays samples/*.mino or given records headless and reports ns/op.\n\n"
+
+#define DEFAULT_ROUNDS 100
+#define ATTEMPTS_PER_ROUND 64
+#define BENCH_SEED 1 /* presets get the same figures on every run */
+
+
+/**************************************
+
+           Synthetic games
+
+**************************************/
+
+static struct OmniParms Synthetic[] = {
+  /* tetrominoes, 10 x 256, full rows are discarded */
+  {0, 0, 4, 4, 1, 1, 1, FILL_GOAL, 10, 256, 0, 0, 0},
+  /* 1..5 blocks, 32 x 256, random prefill */
+  {0, 1, 5, 1, 1, 0, 1, FILL_GOAL, 32, 256, 64, 16, 0},
+  /* tetrominoes, 128 x 64, multi-word rows */
+  {0, 0, 4, 4, 1, 1, 1, FILL_GOAL, 128, 64, 8, 96, 0},
+  /* tetrominoes, 256 x 64, the widest glass, drawn rows */
+  {0, 0, 4, 4, 1, 1, 1, FILL_GOAL, 256, 64, 32, 192, 0},
+};
+
+#define SYNTHETIC_NUM (sizeof(Synthetic) / sizeof(struct OmniParms))
+
+
+/* Random column, rotation and depth for each figure until the game is over */
+
+static void AutoPlay(struct Omnimino *G) {
+  struct Coord **F;
+  unsigned int i, n;
+
+  srand(1);
+
+  G->V.CurFigure = G->D.NextFigure + 1;
+  GetGlassState(G);
+
+  while ((!G->V.GameOver) && (G->V.CurFigure < G->D.LastFigure)) {
+    F = G->V.CurFigure;
+
+    for (n = rand() % 4; n > 0; n--)
+      ExecuteKey(G, 'f');
+    for (i = 0; i < G->P.GlassWidth; i++)
+      ExecuteKey(G, 'h');
+    for (n = rand() % G->P.GlassWidth; n > 0; n--)
+      ExecuteKey(G, 'l');
+    for (n = rand() % G->V.FieldSize; n > 0; n--)
+      ExecuteKey(G, 'j');
+
+    for (i = 0; (i < G->V.FieldSize) && (G->V.CurFigure == F); i++) {
+      ExecuteKey(G, ' ');
+      GetGlassState(G);
+      ExecuteKey(G, 'k'); /* overlaps without gravity, try higher */
+    }
+
+    if (G->V.CurFigure == F)
+      break;
+  }
+
+  EndGame(G);
+}
+
+
+/**************************************
+
+           Measurements
+
+**************************************/
+
+enum BenchOps {
+  OP_LOAD_TEXT,
+  OP_LOAD_BINARY,
+  OP_SAVE_TEXT,
+  OP_SAVE_BINARY,
+  OP_REPLAY,
+  OP_DROP,
+  OP_ATTEMPT,
+  OP_SKIP,
+  OP_ROW_IMAGE,
+  OP_NUM
+};
+
+static const char *OpName[OP_NUM] = {
+  "LoadGame(t)", "LoadGame(b)", "SaveGame(t)", "SaveGame(b)",
+  "GetGlassState", "Drop", "Attempt", "Skip", "PutRowImage"
+};
+
+struct BenchStat {
+  unsigned int Figures;
+  double Ns[OP_NUM];
+  double Ops[OP_NUM];
+};
+
+
+static double Now(void) {
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+
+  return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+
+static void Account(struct BenchStat *S, int Op, double Start, double Ops) {
+  S->Ns[Op] += Now() - Start;
+  S->Ops[Op] += Ops;
+}
+
+
+static void PrintStat(char *Name, struct BenchStat *S) {
+  int i;
+
+  printf("%-40s %7u", Name, S->Figures);
+  for (i = 0; i < OP_NUM; i++) {
+    if (S->Ops[i] > 0)
+      printf(" %13.0f", S->Ns[i] / S->Ops[i]);
+    else
+      printf(" %13s", "-");
+  }
+  printf("\n");
+}
+
+
+/* Records of the game left in TmpDir when the bench stops early */
+
+static void RemoveSaved(char Saved[2][OM_STRLEN + 1]) {
+  int f;
+
+  for (f = FORMAT_TEXT; f <= FORMAT_BINARY; f++) {
+    if (Saved[f][0])
+      unlink(Saved[f]);
+    Saved[f][0] = '\0';
+  }
+}
+
+
+/* Every figure dropped onto the glass it was played on, from the prefilled one */
+
+static void TimeDrops(struct Omnimino *G, unsigned int Figures, struct BenchStat *S) {
+  struct FigureMask M;
+  struct Coord **F;
+  double Start;
+
+  G->V.CheckpointNum = 0;
+  G->V.CurFigure = G->D.NextFigure + 1;
+  G->D.NextFigure = G->M.Figure;
+  GetGlassState(G);
+
+  Start = Now();
+  for (F = G->M.Figure; (F < G->M.Figure + Figures) && (!G->V.GameOver); F++) {
+    GetMask(F, &M);
+    if (!CanDrop(G, &M))
+      break;
+    DropFigure(G, &M);
+  }
+  Account(S, OP_DROP, Start, F - G->M.Figure);
+
+  G->V.CurFigure = G->M.Figure + Figures + 1; /* the glass is rewound by the next GetGlassState */
+}
+
+
+static int BenchGame(struct Omnimino *G, char *Name, unsigned int Rounds, struct BenchStat *Total) {
+  struct BenchStat S;
+  char Saved[2][OM_STRLEN + 1];
+  char Image[MAX_GLASS_WIDTH * 2];
+  unsigned int i, r, Figures;
+  double Start;
+  int f;
+
+  memset(&S, 0, sizeof(S));
+  Saved[FORMAT_TEXT][0] = Saved[FORMAT_BINARY][0] = '\0';
+
+  if (G->V.GameType == 2) {
+    if (NewGame(G, BENCH_SEED, FIGURES_GROWN) != 0)
+      return 1;
+    AutoPlay(G);
+  }
+
+  for (f = FORMAT_TEXT; f <= FORMAT_BINARY; f++) {
+    G->V.RecordFormat = f;
+    Start = Now();
+    for (r = 0; r < Rounds; r++) {
+      if (r > 0)
+        unlink(Saved[f]);
+      SaveGame(G);
+      if (G->V.GameType == 3) {
+        RemoveSaved(Saved);
+        return 1;
+      }
+      strcpy(Saved[f], G->S.GameName);
+    }
+    Account(&S, OP_SAVE_TEXT + f, Start, Rounds);
+  }
+
+  for (f = FORMAT_TEXT; f <= FORMAT_BINARY; f++) {
+    Start = Now();
+    for (r = 0; r < Rounds; r++) {
+      if (LoadGame(G, Saved[f]) != 0) {
+        RemoveSaved(Saved);
+        return 1;
+      }
+    }
+    Account(&S, OP_LOAD_TEXT + f, Start, Rounds);
+    unlink(Saved[f]);
+    Saved[f][0] = '\0';
+  }
+
+  S.Figures = Figures = G->D.NextFigure - G->M.Figure;
+
+  if (Figures > 0) {
+    Start = Now();
+    for (r = 0; r < Rounds; r++) {
+      G->V.CheckpointNum = 0;
+      G->V.CurFigure = G->D.NextFigure + 1;
+      GetGlassState(G);
+    }
+    Account(&S, OP_REPLAY, Start, Rounds);
+    for (r = 0; r < Rounds; r++)
+      TimeDrops(G, Figures, &S);
+
+    G->D.NextFigure = G->M.Figure + Figures / 2;
+    GetGlassState(G);
+
+    Start = Now(); /* as the screen is drawn */
+    for (r = 0; r < Rounds; r++) {
+      for (i = 0; i < G->V.FieldSize; i++)
+        PutRowImage(G->M.GlassRow + i * G->C.RowWords, Image, G->P.GlassWidth);
+    }
+    Account(&S, OP_ROW_IMAGE, Start, (double) Rounds * G->V.FieldSize);
+
+    Start = Now();
+    for (r = 0; r < Rounds; r++) {
+      for (i = 0; i < ATTEMPTS_PER_ROUND; i++)
+        ExecuteKey(G, "hlfa"[i & 3]);
+    }
+    Account(&S, OP_ATTEMPT, Start, (double) Rounds * ATTEMPTS_PER_ROUND);
+
+    if (!G->P.FixedSequence) {
+      Start = Now();
+      for (r = 0; r < Rounds; r++) {
+        for (i = 0; i < ATTEMPTS_PER_ROUND; i++) {
+          ExecuteKey(G, "nnnN"[i & 3]);
+          GetGlassState(G);
+        }
+      }
+      Account(&S, OP_SKIP, Start, (double) Rounds * ATTEMPTS_PER_ROUND);
+      EndGame(G);
+    }
+  }
+
+  PrintStat(Name, &S);
+
+  Total->Figures += Figures;
+  for (i = 0; i < OP_NUM; i++) {
+    Total->Ns[i] += S.Ns[i];
+    Total->Ops[i] += S.Ops[i];
+  }
+
+  return 0;
+}
+
+
+/**************************************
+
+           main
+
+**************************************/
+
+int main(int argc, char *argv[]) {
+  unsigned int i, Rounds = DEFAULT_ROUNDS, FileNum;
+  char **FileName, **Path, Name[OM_STRLEN + 1], TmpDir[] = "/tmp/omnibench.XXXXXX";
+  struct Omnimino Game;
+  struct BenchStat Total;
+  glob_t Samples;
+  int Opt;
+
+  while ((Opt = getopt(argc, argv, "n:")) != -1) {
+    switch (Opt) {
+      case 'n':
+        Rounds = strtoul(optarg, NULL, 10);
+        break;
+      default:
+        fprintf(stdout, USAGE);
+        return 1;
+    }
+  }
+
+  if (Rounds == 0)
+    Rounds = 1;
+
+  memset(&Samples, 0, sizeof(Samples));
+  if (optind < argc) {
+    FileName = argv + optind;
+    FileNum = argc - optind;
+  } else {
+    glob("samples/*.mino", 0, NULL, &Samples);
+    FileName = Samples.gl_pathv;
+    FileNum = Samples.gl_pathc;
+  }
+
+  Path = calloc(FileNum + 1, sizeof(char *));
+  if (Path == NULL)
+    return 1;
+
+  for (i = 0; i < FileNum; i++) { /* records are saved into TmpDir */
+    Path[i] = realpath(FileName[i], NULL);
+    if (Path[i] == NULL)
+      Path[i] = strdup(FileName[i]);
+  }
+
+  if ((mkdtemp(TmpDir) == NULL) || (chdir(TmpDir) != 0)) {
+    fprintf(stderr, "Can not create %s.\n", TmpDir);
+    return 1;
+  }
+
+  printf("%-40s %7s", "Record", "Figures");
+  for (i = 0; i < OP_NUM; i++)
+    printf(" %13s", OpName[i]);
+  printf("\n");
+
+  memset(&Total, 0, sizeof(Total));
+  InitGame(&Game);
+
+  for (i = 0; i < FileNum; i++) {
+    snprintf(Name, OM_STRLEN + 1, "%s", basename(FileName[i]));
+    if ((LoadGame(&Game, Path[i]) != 0) || (BenchGame(&Game, Name, Rounds, &Total) != 0))
+      fprintf(stdout, "%-40s %s\n", Name, Game.S.MsgBuf);
+  }
+
+  for (i = 0; i < SYNTHETIC_NUM; i++) {
+    snprintf(Name, OM_STRLEN + 1, "synthetic-%u", i + 1);
+    Game.P = Synthetic[i];
+    strcpy(Game.S.ParentName, "none");
+    Game.V.GameType = 2;
+    Game.V.RecordFormat = FORMAT_TEXT;
+    if ((CheckParameters(&Game) != 0) || (BenchGame(&Game, Name, Rounds, &Total) != 0))
+      fprintf(stdout, "%-40s %s\n", Name, Game.S.MsgBuf);
+  }
+
+  PrintStat("Total", &Total);
+
+  if (chdir("/") == 0)
+    rmdir(TmpDir);
+
+  for (i = 0; i < FileNum; i++)
+    free(Path[i]);
+  free(Path);
+  free(Game.M.Figure);
+  globfree(&Samples);
+
+  return 0;
+}
+
@@ -0,0 +1,252 @@
+#define _GNU_SOURCE 1
+
+#include <features.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "omnicache.h"
+
+/**************************************
+
+      Catalogue metadata cache
+
+  Batch reports of unchanged files are
+  kept on disk, keyed by device and
+  inode and validated by size, mtime
+  and file name.
+
+**************************************/
+
+#define CACHE_MAGIC "omnicache 1\n"
+
+struct CacheEntry {
+  unsigned long long Dev;
+  unsigned long long Ino;
+  unsigned long long Size;
+  long long MTime;
+  long long MTimeNsec;
+  struct OmniParms P;
+  unsigned int GameType;
+  unsigned int TimeStamp;
+  unsigned int Used;
+  char MsgBuf[OM_STRLEN + 1];
+  char GameName[OM_STRLEN + 1];
+  char ParentName[OM_STRLEN + 1];
+  char PlayerName[OM_STRLEN + 1];
+};
+
+
+static unsigned int HashKey(unsigned long long Dev, unsigned long long Ino) {
+  unsigned long long h = (Dev * 0x9e3779b97f4a7c15ULL) ^ Ino;
+
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+
+  return (unsigned int) h;
+}
+
+
+static unsigned int *FindSlot(struct OmniCache *C, unsigned long long Dev, unsigned long long Ino) {
+  unsigned int i = HashKey(Dev, Ino) & C->IndexMask;
+  struct CacheEntry *E;
+
+  for (; C->Index[i]; i = (i + 1) & C->IndexMask) {
+    E = C->Entry + C->Index[i] - 1;
+    if ((E->Dev == Dev) && (E->Ino == Ino))
+      break;
+  }
+
+  return C->Index + i;
+}
+
+
+static int Reindex(struct OmniCache *C, unsigned int Size) {
+  unsigned int i, *NewIndex = calloc(Size, sizeof(unsigned int));
+  struct CacheEntry *E;
+
+  if (NewIndex == NULL)
+    return 1;
+
+  free(C->Index);
+  C->Index = NewIndex;
+  C->IndexMask = Size - 1;
+
+  for (i = 0, E = C->Entry; i < C->EntryNum; i++, E++)
+    *FindSlot(C, E->Dev, E->Ino) = i + 1;
+
+  return 0;
+}
+
+
+static struct CacheEntry *NewEntry(struct OmniCache *C) {
+  if (C->EntryNum == C->EntryMax) {
+    unsigned int NewMax = C->EntryMax ? (C->EntryMax * 2) : 1024;
+    struct CacheEntry *NewBuf = realloc(C->Entry, NewMax * sizeof(struct CacheEntry));
+    if (NewBuf == NULL)
+      return NULL;
+    C->Entry = NewBuf;
+    C->EntryMax = NewMax;
+  }
+
+  if ((C->EntryNum * 2) >= C->IndexMask) {
+    if (Reindex(C, (C->IndexMask + 1) * 2) != 0)
+      return NULL;
+  }
+
+  return C->Entry + C->EntryNum++;
+}
+
+
+int LoadCache(struct OmniCache *C, char *Name) {
+  FILE *fin;
+  char Magic[sizeof(CACHE_MAGIC)];
+  unsigned int EntrySize;
+  struct CacheEntry *E;
+
+  memset(C, 0, sizeof(struct OmniCache));
+  pthread_mutex_init(&C->Lock, NULL);
+
+  if (Reindex(C, 2048) != 0)
+    return 1;
+
+  fin = fopen(Name, "r");
+  if (fin == NULL)
+    return 0; /* no cache yet */
+
+  if ((fread(Magic, 1, sizeof(Magic), fin) == sizeof(Magic)) &&
+      (memcmp(Magic, CACHE_MAGIC, sizeof(Magic)) == 0) &&
+      (fread(&EntrySize, sizeof(EntrySize), 1, fin) == 1) &&
+      (EntrySize == sizeof(struct CacheEntry))) {
+    while ((E = NewEntry(C)) != NULL) {
+      if (fread(E, sizeof(struct CacheEntry), 1, fin) != 1) {
+        C->EntryNum--;
+        break;
+      }
+      E->Used = 0;
+      *FindSlot(C, E->Dev, E->Ino) = C->EntryNum;
+    }
+  }
+
+  fclose(fin);
+
+  return 0;
+}
+
+
+/* Only the entries met during this run are written back */
+
+int SaveCache(struct OmniCache *C, char *Name) {
+  char TmpName[PATH_MAX];
+  unsigned int i, Used, EntrySize = sizeof(struct CacheEntry);
+  struct CacheEntry *E;
+  FILE *fout;
+  int Err = 0;
+
+  for (i = 0, Used = 0, E = C->Entry; i < C->EntryNum; i++, E++)
+    Used += E->Used;
+
+  if (C->Modified || (Used != C->EntryNum)) {
+    snprintf(TmpName, sizeof(TmpName), "%s.tmp", Name);
+    fout = fopen(TmpName, "w");
+    if (fout == NULL) {
+      Err = 1;
+    } else {
+      Err = (fwrite(CACHE_MAGIC, 1, sizeof(CACHE_MAGIC), fout) != sizeof(CACHE_MAGIC)) ||
+            (fwrite(&EntrySize, sizeof(EntrySize), 1, fout) != 1);
+      for (i = 0, E = C->Entry; (!Err) && (i < C->EntryNum); i++, E++) {
+        if (E->Used)
+          Err = (fwrite(E, sizeof(struct CacheEntry), 1, fout) != 1);
+      }
+      Err = (fclose(fout) != 0) || Err;
+      if (Err || (rename(TmpName, Name) != 0)) {
+        remove(TmpName);
+        Err = 1;
+      }
+    }
+  }
+
+  free(C->Index);
+  free(C->Entry);
+  pthread_mutex_destroy(&C->Lock);
+
+  return Err;
+}
+
+
+static int SameFile(struct CacheEntry *E, struct stat *st) {
+  return (E->Size == (unsigned long long) st->st_size) &&
+         (E->MTime == (long long) st->st_mtim.tv_sec) &&
+         (E->MTimeNsec == (long long) st->st_mtim.tv_nsec);
+}
+
+
+int FindCached(struct OmniCache *C, char *Name, struct stat *st, struct Omnimino *G) {
+  unsigned int N;
+  struct CacheEntry *E;
+  int Err = 1;
+
+  pthread_mutex_lock(&C->Lock);
+
+  N = *FindSlot(C, st->st_dev, st->st_ino);
+  if (N) {
+    E = C->Entry + N - 1;
+    if (SameFile(E, st) && (strcmp(E->GameName, basename(Name)) == 0)) {
+      E->Used = 1;
+      G->P = E->P;
+      G->V.GameType = E->GameType;
+      G->D.TimeStamp = E->TimeStamp;
+      strcpy(G->S.MsgBuf, E->MsgBuf);
+      strcpy(G->S.GameName, E->GameName);
+      strcpy(G->S.ParentName, E->ParentName);
+      strcpy(G->S.PlayerName, E->PlayerName);
+      G->D.LastFigure = G->M.Figure; /* no game data, the score is in MsgBuf */
+      Err = 0;
+    }
+  }
+
+  pthread_mutex_unlock(&C->Lock);
+
+  return Err;
+}
+
+
+void StoreCached(struct OmniCache *C, struct stat *st, struct Omnimino *G) {
+  unsigned int *Slot;
+  struct CacheEntry *E;
+
+  pthread_mutex_lock(&C->Lock);
+
+  Slot = FindSlot(C, st->st_dev, st->st_ino);
+  if (*Slot) {
+    E = C->Entry + *Slot - 1;
+  } else {
+    E = NewEntry(C);
+    if (E) /* the index may be rebuilt */
+      *FindSlot(C, st->st_dev, st->st_ino) = C->EntryNum;
+  }
+
+  if (E) {
+    memset(E, 0, sizeof(struct CacheEntry));
+    E->Dev = st->st_dev;
+    E->Ino = st->st_ino;
+    E->Size = st->st_size;
+    E->MTime = st->st_mtim.tv_sec;
+    E->MTimeNsec = st->st_mtim.tv_nsec;
+    E->P = G->P;
+    E->GameType = G->V.GameType;
+    E->TimeStamp = G->D.TimeStamp;
+    E->Used = 1;
+    strcpy(E->MsgBuf, G->S.MsgBuf);
+    strcpy(E->GameName, G->S.GameName);
+    strcpy(E->ParentName, G->S.ParentName);
+    strcpy(E->PlayerName, G->S.PlayerName);
+    C->Modified = 1;
+  }
+
+  pthread_mutex_unlock(&C->Lock);
+}
+
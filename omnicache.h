@@ -0,0 +1,28 @@
+#ifndef _OMNICACHE_H
+
+#define _OMNICACHE_H 1
+
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "omnitype.h"
+
+struct CacheEntry;
+
+struct OmniCache {
+  pthread_mutex_t Lock;
+  struct CacheEntry *Entry;
+  unsigned int EntryNum;
+  unsigned int EntryMax;
+  unsigned int *Index;      /* entry number + 1, 0 - empty slot */
+  unsigned int IndexMask;
+  int Modified;
+};
+
+int LoadCache(struct OmniCache *C, char *Name);
+int SaveCache(struct OmniCache *C, char *Name);
+int FindCached(struct OmniCache *C, char *Name, struct stat *st, struct Omnimino *G);
+void StoreCached(struct OmniCache *C, struct stat *st, struct Omnimino *G);
+
+#endif
+
@@ -1,13 +1,14 @@
+#include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 
 #include <curses.h>
 
 #include "../omnifunc.h"
+#include "../omnigame.h"
+#include "../omnirow.h"
 
 
-
-static struct Omnimino *GG;
-
 #include "../omnimino.def"
 
 
@@ -37,6 +38,40 @@ static SCREEN *Screen = NULL;
 static WINDOW *MyScr = NULL;
 
 
+/**************************************
+
+	Damage tracking
+
+  MyScr contents are remembered, so that
+  only glass rows whose blocks changed
+  or which the figure left or entered,
+  and queue places whose figure changed,
+  are drawn again. Any change of the
+  glass view draws it all.
+
+**************************************/
+
+struct QueuePlace {
+  struct Coord *Source;                /* NULL - the place is empty */
+  unsigned int Len;
+  struct Coord Raw[MAX_FIGURE_SIZE];   /* Source blocks as drawn */
+  struct Coord Shape[MAX_FIGURE_SIZE]; /* normalized, on the screen grid */
+};
+
+static struct {
+  int Valid;                     /* 0 - MyScr is to be drawn anew */
+  int GlassRowN, Wall;
+  unsigned int Height, Field;    /* GlassHeight, FieldSize */
+  unsigned int Empty;            /* EmptyCells */
+  unsigned int FigureLen;
+  struct Coord Blocks[MAX_FIGURE_SIZE]; /* CurFigure as drawn */
+  int FigureTop, FigureBottom;   /* screen rows */
+  unsigned int *Row;             /* MAX_ROW_WORDS per screen row */
+  int Places;
+  struct QueuePlace *Place, *Prev;
+} Shown;
+
+
 void OpenScreen(void) {
   Screen = newterm(NULL, stderr, stdin);
   if (Screen) {
@@ -53,6 +88,26 @@ static void DeleteMyScr(void) {
     delwin(MyScr);
     MyScr = NULL;
   }
+  free(Shown.Row);
+  free(Shown.Place);
+  free(Shown.Prev);
+  memset(&Shown, 0, sizeof(Shown));
+}
+
+
+/* Returns 0 if out of memory */
+
+static int NewMyScr(void) {
+  if ((MyScr = newwin(0, 0, 0, 0)) == NULL)
+    return 0;
+
+  Shown.Row = malloc(getmaxy(MyScr) * MAX_ROW_WORDS * sizeof(unsigned int));
+  if (Shown.Row == NULL) {
+    DeleteMyScr();
+    return 0;
+  }
+
+  return 1;
 }
 
 
@@ -68,35 +123,46 @@ void CloseScreen(void) {
 
 #define MAX_ROW_LEN ((MAX_GLASS_WIDTH + THICKNESS) * 2)
 
-static void PutRowImage(unsigned int Row, char *Image, int N) {
-  for (;N--; Row >>= 1) {
-    *Image++ = (Row & 1) ? '[' : ' ';
-    *Image++ = (Row & 1) ? ']' : ' ';
-  }
-}
-
+/* Rows from Top to Bottom are drawn in any case, returns the number of rows drawn */
 
-static void DrawGlass(int GlassRowN) {
-  int RowN;
+static int DrawGlass(struct Omnimino *GG, int GlassRowN, int Wall, int Top, int Bottom) {
+  int RowN, Drawn = 0;
   char RowImage[MAX_ROW_LEN];
   int RowWidth = (GlassWidth + THICKNESS) * 2;
   int Visible;
-  int Wall = GameOver ? (GoalReached ? WIN_SYM : LOOSE_SYM) : GOAL_SYM[Goal];
+  unsigned int *Row, *Seen;
 
   Visible = (getmaxy(MyScr) * getmaxy(MyScr)) / (GlassRowN + 1);
 
   for (RowN = 0; RowN < getmaxy(MyScr); RowN++, GlassRowN--) {
+    int Dirty = (!Shown.Valid) || ((RowN >= Top) && (RowN <= Bottom));
+
+    if ((GlassRowN >= 0) && (GlassRowN < (int)FieldSize)) {
+      Row = GlassRow + GlassRowN * RowWords;
+      Seen = Shown.Row + RowN * MAX_ROW_WORDS;
+      if ((!Shown.Valid) || memcmp(Seen, Row, RowWords * sizeof(unsigned int))) {
+        memcpy(Seen, Row, RowWords * sizeof(unsigned int));
+        Dirty = 1;
+      }
+    }
+
+    if (!Dirty)
+      continue;
+
     memset(RowImage, (GlassRowN < (int)GlassHeight) ? Wall : ' ', RowWidth);
     if ((GlassRowN >= 0) && (GlassRowN < (int)FieldSize))
-      PutRowImage(GlassRow[GlassRowN], RowImage+THICKNESS, GlassWidth);
+      PutRowImage(GlassRow + GlassRowN * RowWords, RowImage+THICKNESS, GlassWidth);
     if (RowN >= Visible)
       RowImage[RowWidth - 1] = BELOW_SYM;
     mvwaddnstr(MyScr, RowN, 0, RowImage, RowWidth);
+    Drawn++;
   }
+
+  return Drawn;
 }
 
 
-static int SelectGlassRow(void) {
+static int SelectGlassRow(struct Omnimino *GG) {
   int FCV = Center(CurFigure, FindBottom, FindTop) >> 1;
   unsigned int GlassRowN = FCV + (FigureSize / 2) + 1;
 
@@ -122,19 +188,57 @@ static void DrawBlock(struct Coord *B, int *GRN) {
 }
 
 
-static void DrawFigure(struct Coord **F, struct Coord *Buf, int OffsetX, int OffsetY) {
+static void DrawFigure(struct Omnimino *GG, struct Coord **F, int OffsetX, int OffsetY) {
   CopyFigure(FigureBuf, F);
-  if (Buf)
-    Normalize(FigureBuf, Buf);
   ForEachIn(FigureBuf, AndX, ~1);
   ForEachIn(FigureBuf, AddX, OffsetX);
   ForEachIn(FigureBuf, DrawBlock, OffsetY);
 }
 
 
-static void DrawQueue(void) {
-  int x, y;
+static void DrawShape(struct QueuePlace *P, int OffsetX, int OffsetY, attr_t Attr) {
+  unsigned int i;
+
+  for (i = 0; i < P->Len; i++)
+    mvwchgat(MyScr, OffsetY - (P->Shape[i].y >> 1), OffsetX + P->Shape[i].x, 2, Attr, 0, NULL);
+}
+
+
+/* The figure may have moved to the neighbouring place since it was normalized */
+
+static void ShapeQueued(struct Omnimino *GG, struct QueuePlace *P, int N, struct Coord **View) {
+  struct QueuePlace *Q;
   struct Coord C;
+  int d;
+
+  P->Source = View[0];
+  P->Len = View[1] - View[0];
+  memcpy(P->Raw, View[0], P->Len * sizeof(struct Coord));
+
+  for (d = 1; d >= -1; d -= 2) {
+    if ((N + d < 0) || (N + d >= Shown.Places))
+      continue;
+    Q = Shown.Prev + N + d;
+    if ((Q->Source == P->Source) && (Q->Len == P->Len) &&
+        (memcmp(Q->Raw, P->Raw, P->Len * sizeof(struct Coord)) == 0)) {
+      memcpy(P->Shape, Q->Shape, P->Len * sizeof(struct Coord));
+      return;
+    }
+  }
+
+  CopyFigure(FigureBuf, View);
+  Normalize(FigureBuf, &C);
+  ForEachIn(FigureBuf, AndX, ~1);
+  memcpy(P->Shape, FigureBuf[0], P->Len * sizeof(struct Coord));
+}
+
+
+/* Returns the number of places drawn, -1 if out of memory */
+
+static int DrawQueue(struct Omnimino *GG) {
+  int x, y, N, Drawn = 0;
+  struct Coord *View[2];
+  struct QueuePlace *P;
 
   int SideLen = FigureSize + 2;
   int TwiSide = SideLen * 2;
@@ -147,21 +251,56 @@ static void DrawQueue(void) {
   int OffsetX = LeftMargin + SideLen;
   int OffsetYInit = SideLen / 2;
 
-  for (x = 0; (F < LastFigure) && (x < PlacesH); x++, OffsetX += TwiSide) {
+  if (Shown.Place == NULL) {
+    Shown.Places = (PlacesH > 0) ? PlacesH * PlacesV : 0;
+    Shown.Place = calloc(Shown.Places + 1, sizeof(struct QueuePlace));
+    Shown.Prev = calloc(Shown.Places + 1, sizeof(struct QueuePlace));
+    if ((Shown.Place == NULL) || (Shown.Prev == NULL))
+      return -1;
+  }
+
+  memcpy(Shown.Prev, Shown.Place, Shown.Places * sizeof(struct QueuePlace));
+
+  for (N = 0, x = 0; x < PlacesH; x++, OffsetX += TwiSide) {
 
     int OffsetY = OffsetYInit;
 
-    for (y = 0; (F < LastFigure) && (y < PlacesV); y++, OffsetY += SideLen, F++){
-      DrawFigure(F, &C, OffsetX, OffsetY);
+    for (y = 0; y < PlacesV; y++, OffsetY += SideLen, N++){
+      int Filled = F < LastFigure;
+
+      P = Shown.Place + N;
+
+      if (Filled)
+        PeekFigure(GG, F++, View);
+
+      if (Shown.Valid) {
+        if (Filled && (P->Source == View[0]) && (P->Len == (unsigned int) (View[1] - View[0])) &&
+            (memcmp(P->Raw, View[0], P->Len * sizeof(struct Coord)) == 0))
+          continue;
+        if ((!Filled) && (P->Source == NULL))
+          continue;
+        DrawShape(P, OffsetX, OffsetY, A_NORMAL);
+      }
+
+      if (Filled) {
+        ShapeQueued(GG, P, N, View);
+        DrawShape(P, OffsetX, OffsetY, A_REVERSE);
+      } else {
+        P->Source = NULL;
+        P->Len = 0;
+      }
+      Drawn++;
     }
   }
+
+  return Drawn;
 }
 
 
 #define SCORE_WIDTH 12
 #define SCORE_FORMAT "  %-5d%5d"
 
-static void DrawStatus(void) {
+static void DrawStatus(struct Omnimino *GG) {
   int ScoreX = getmaxx(MyScr) - SCORE_WIDTH;
 
   mvwhline(MyScr, getmaxy(MyScr) - 2, ScoreX, ' ', SCORE_WIDTH);
@@ -181,29 +320,63 @@ static void DrawStatus(void) {
 }
 
 
-int ShowScreen(struct Omnimino *G) {
-  GG = G; 
+int ShowScreen(struct Omnimino *GG) {
 
   if (Screen) {
     if (MyScr == NULL) {
-      if ((MyScr = newwin(0, 0, 0, 0)) == NULL)
+      if (NewMyScr() == 0)
         return 0;
       refresh();
     }
 
-    werase(MyScr);
-
     if ((getmaxx(MyScr) < SCORE_WIDTH) ||
         (getmaxx(MyScr) < (int)((GlassWidth + THICKNESS) * 2)) ||
         (getmaxy(MyScr) < (int)((FigureSize * 2) + 2))){
+      werase(MyScr);
       mvwaddstr(MyScr, 0, 0, "small");
+      Shown.Valid = 0;
     } else {
-      int GlassRowN = SelectGlassRow();
+      int GlassRowN = SelectGlassRow(GG);
+      int Wall = GameOver ? (GoalReached ? WIN_SYM : LOOSE_SYM) : GOAL_SYM[Goal];
+      unsigned int Len = CurFigure[1] - CurFigure[0];
+      int Top = GlassRowN - (ForEachIn(CurFigure, FindTop, INT_MIN) >> 1);
+      int Bottom = GlassRowN - (ForEachIn(CurFigure, FindBottom, INT_MAX) >> 1);
+      int Rows, Places;
+
+      if ((GlassRowN != Shown.GlassRowN) || (Wall != Shown.Wall) ||
+          (GlassHeight != Shown.Height) || (FieldSize != Shown.Field))
+        Shown.Valid = 0;
+
+      if (!Shown.Valid) {
+        werase(MyScr);
+        Rows = DrawGlass(GG, GlassRowN, Wall, Top, Bottom);
+      } else if ((Len == Shown.FigureLen) &&
+                 (memcmp(Shown.Blocks, CurFigure[0], Len * sizeof(struct Coord)) == 0)) {
+        Rows = DrawGlass(GG, GlassRowN, Wall, 1, 0);
+      } else {
+        Rows = DrawGlass(GG, GlassRowN, Wall, (Top < Shown.FigureTop) ? Top : Shown.FigureTop,
+                         (Bottom > Shown.FigureBottom) ? Bottom : Shown.FigureBottom) + 1;
+      }
+
+      if (Rows)
+        DrawFigure(GG, CurFigure, THICKNESS, GlassRowN);
+
+      if ((Places = DrawQueue(GG)) < 0)
+        return 0;
 
-      DrawGlass(GlassRowN);
-      DrawFigure(CurFigure, NULL, THICKNESS, GlassRowN);
-      DrawQueue();
-      DrawStatus();
+      if (Rows || Places || (!Shown.Valid) || (EmptyCells != Shown.Empty))
+        DrawStatus(GG);
+
+      Shown.Valid = 1;
+      Shown.GlassRowN = GlassRowN;
+      Shown.Wall = Wall;
+      Shown.Height = GlassHeight;
+      Shown.Field = FieldSize;
+      Shown.Empty = EmptyCells;
+      Shown.FigureLen = Len;
+      memcpy(Shown.Blocks, CurFigure[0], Len * sizeof(struct Coord));
+      Shown.FigureTop = Top;
+      Shown.FigureBottom = Bottom;
     }
 
     wrefresh(MyScr);
@@ -221,6 +394,7 @@ int ReadKey(void) {
   case KEY_UP:		Key = 'k'; break;
   case KEY_DOWN:	Key = 'j'; break;
   case KEY_RESIZE:	Key = '*'; DeleteMyScr(); break;
+  case '*':		Shown.Valid = 0; break;
   }
 
   return Key;
@@ -1,7 +1,9 @@
+#include <assert.h>
 #include <limits.h>
 #include <string.h>
 
 #include "omnitype.h"
+#include "omnifunc.h"
 
 
 /**************************************
@@ -92,6 +94,183 @@ void Normalize(struct Coord **F,struct Coord *C){
 }
 
 
+/* Rotation or shift around the figure center, as the player moves it */
+
+void Transform(struct Coord **F, bfunc Func, int V){
+  struct Coord C;
+
+  Normalize(F, &C);
+  ForEachIn(F, Func, V);
+  ForEachIn(F, AddX, C.x);
+  ForEachIn(F, AddY, C.y);
+}
+
+
+/**************************************
+
+          Orientation tables
+
+**************************************/
+
+/* Orientation i is NegX applied (i >> 2) times, then RotCW (i & 3) times */
+
+static const int TurnIndex[MAX_TURN][ORIENT_NUM] = {
+  {1, 2, 3, 0, 5, 6, 7, 4},  /* TURN_CW */
+  {3, 0, 1, 2, 7, 4, 5, 6},  /* TURN_CCW */
+  {4, 7, 6, 5, 0, 3, 2, 1}   /* TURN_MIRROR */
+};
+
+static const bfunc TurnFunc[MAX_TURN] = {RotCW, RotCCW, NegX};
+
+
+/*
+  Figure masks are turned as 8 x 8 bit boards, then moved back to the
+  lowest row and the leftmost column.
+*/
+
+static unsigned long long Transpose(unsigned long long b) {
+  unsigned long long t;
+
+  t = 0x0f0f0f0f00000000ULL & (b ^ (b << 28)); b ^= t ^ (t >> 28);
+  t = 0x3333000033330000ULL & (b ^ (b << 14)); b ^= t ^ (t >> 14);
+  t = 0x5500550055005500ULL & (b ^ (b << 7));  b ^= t ^ (t >> 7);
+
+  return b;
+}
+
+static unsigned long long MirrorColumns(unsigned long long b) {
+  b = ((b >> 1) & 0x5555555555555555ULL) | ((b & 0x5555555555555555ULL) << 1);
+  b = ((b >> 2) & 0x3333333333333333ULL) | ((b & 0x3333333333333333ULL) << 2);
+  b = ((b >> 4) & 0x0f0f0f0f0f0f0f0fULL) | ((b & 0x0f0f0f0f0f0f0f0fULL) << 4);
+
+  return b;
+}
+
+static unsigned int FoldRows(unsigned long long b) {
+  b |= b >> 32;
+  b |= b >> 16;
+  b |= b >> 8;
+
+  return (unsigned int) b & 0xff;
+}
+
+static unsigned long long Justify(unsigned long long b) {
+  b >>= __builtin_ctzll(b) & ~7;
+
+  return b >> __builtin_ctz(FoldRows(b));
+}
+
+/* (x, y) -> (y, -x) as RotCW() */
+
+static unsigned long long RotateBits(unsigned long long b) {
+  return Justify(__builtin_bswap64(Transpose(b)));
+}
+
+/* (x, y) -> (-x, y) as NegX() */
+
+static unsigned long long MirrorBits(unsigned long long b) {
+  return Justify(MirrorColumns(b));
+}
+
+
+void BuildOrientations(struct Coord **F, struct OrientTable *T){
+  struct Coord *P[2];
+  struct FigureMask M;
+  int i, j, r;
+
+  T->N = F[1] - F[0];
+  T->Index = 0;
+
+  GetMask(F, &M);
+
+  for (i = 0; i < ORIENT_NUM; i++) {
+    P[0] = T->B[i];
+    P[1] = T->B[i] + T->N;
+    memcpy(P[0], F[0], T->N * sizeof(struct Coord));
+    if (i >> 2)
+      ForEachIn(P, NegX, 0);
+    for (r = i & 3; r > 0; r--)
+      ForEachIn(P, RotCW, 0);
+    Normalize(P, T->K + i);
+
+    T->Min[i].x = ForEachIn(P, FindLeft, INT_MAX);
+    T->Min[i].y = ForEachIn(P, FindBottom, INT_MAX);
+
+    if (i == 0)
+      T->Bits[i] = M.Bits;
+    else if (i == 4)
+      T->Bits[i] = MirrorBits(T->Bits[0]);
+    else
+      T->Bits[i] = RotateBits(T->Bits[i - 1]);
+
+    T->Width[i] = 32 - __builtin_clz(FoldRows(T->Bits[i]));
+    T->Height[i] = ((63 - __builtin_clzll(T->Bits[i])) >> 3) + 1;
+
+    for (j = 0; memcmp(T->B[j], T->B[i], T->N * sizeof(struct Coord)) != 0; j++);
+    T->Same[i] = j;
+  }
+
+  T->C = T->K[0];
+}
+
+
+/* The table describes F in its current orientation and place */
+
+int OrientedAs(struct Coord **F, struct OrientTable *T){
+  struct Coord *B, *O = T->B[T->Index];
+
+  if ((F[1] - F[0]) != T->N)
+    return 0;
+
+  for (B = F[0]; B < F[1]; B++, O++) {
+    if ((B->x != O->x + T->C.x) || (B->y != O->y + T->C.y))
+      return 0;
+  }
+
+  return 1;
+}
+
+
+/* Mask of orientation Index centered at C, the same GetMask() gives for its blocks */
+
+void OrientMask(struct OrientTable *T, int Index, struct Coord *C, struct FigureMask *M){
+  M->Left = (C->x + T->Min[Index].x) >> 1;
+  M->Bottom = (C->y + T->Min[Index].y) >> 1;
+  M->Width = T->Width[Index];
+  M->Height = T->Height[Index];
+  M->Bits = T->Bits[Index];
+}
+
+
+/*
+  Same blocks as Transform() gives: the turned figure center moves by
+  the difference of the turned and unturned source figure centers.
+  Returns the new orientation, C gets the new center.
+*/
+
+int TurnCenter(struct OrientTable *T, int Turn, struct Coord *C){
+  int i = TurnIndex[Turn][T->Index], V;
+  struct Coord D = T->K[T->Index];
+
+  TurnFunc[Turn](&D, &V);
+  C->x = T->C.x + T->K[i].x - D.x;
+  C->y = T->C.y + T->K[i].y - D.y;
+
+  return i;
+}
+
+
+void PlaceOrientation(struct OrientTable *T, int Index, struct Coord *C, struct Coord **Dst){
+  struct Coord *B, *O = T->B[Index];
+
+  Dst[1] = Dst[0] + T->N;
+  for (B = Dst[0]; B < Dst[1]; B++, O++) {
+    B->x = O->x + C->x;
+    B->y = O->y + C->y;
+  }
+}
+
+
 struct Coord *CopyFigure(struct Coord **Dst, struct Coord **Src) {
   int Len = Src[1] - Src[0];
 
@@ -108,3 +287,26 @@ int FindBlock(struct Coord *B, struct Coord *A, int Len) {
   return Len;
 }
 
+
+void GetMask(struct Coord **F, struct FigureMask *M) {
+  struct Coord *B;
+  int Left = INT_MAX, Bottom = INT_MAX, Right = INT_MIN, Top = INT_MIN;
+
+  for (B = F[0]; B < F[1]; B++) {
+    if (Left > (B->x >> 1)) Left = B->x >> 1;
+    if (Right < (B->x >> 1)) Right = B->x >> 1;
+    if (Bottom > (B->y >> 1)) Bottom = B->y >> 1;
+    if (Top < (B->y >> 1)) Top = B->y >> 1;
+  }
+
+  M->Left = Left;
+  M->Bottom = Bottom;
+  M->Width = Right - Left + 1;
+  M->Height = Top - Bottom + 1;
+  M->Bits = 0;
+
+  assert((M->Width <= 8) && (M->Height <= 8)); /* CheckBlocks() and the generators keep figures in */
+
+  for (B = F[0]; B < F[1]; B++)
+    M->Bits |= 1ULL << ((((B->y >> 1) - Bottom) << 3) + (B->x >> 1) - Left);
+}
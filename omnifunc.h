@@ -20,7 +20,14 @@ int ForEachIn(struct Coord **F, bfunc Func, int V);
 int Dimension(struct Coord **F, bfunc FindMin, bfunc FindMax);
 int Center(struct Coord **F, bfunc FindMin, bfunc FindMax);
 void Normalize(struct Coord **F,struct Coord *C);
+void Transform(struct Coord **F, bfunc Func, int V);
+void BuildOrientations(struct Coord **F, struct OrientTable *T);
+int OrientedAs(struct Coord **F, struct OrientTable *T);
+void OrientMask(struct OrientTable *T, int Index, struct Coord *C, struct FigureMask *M);
+int TurnCenter(struct OrientTable *T, int Turn, struct Coord *C);
+void PlaceOrientation(struct OrientTable *T, int Index, struct Coord *C, struct Coord **Dst);
 struct Coord *CopyFigure(struct Coord **Dst, struct Coord **Src);
 int FindBlock(struct Coord *B, struct Coord *A, int Len);
+void GetMask(struct Coord **F, struct FigureMask *M);
 
 #endif
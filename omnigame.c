@@ -1,14 +1,12 @@
 #include "omnitype.h"
 
 #include <string.h>
-#include <limits.h>
 
 #include "omnifunc.h"
+#include "omnirow.h"
 #include "omnidraw/omnidraw.h"
 
 
-static struct Omnimino *GG;
-
 #include "omnimino.def"
 
 
@@ -18,41 +16,123 @@ static struct Omnimino *GG;
 
 **************************************/
 
-static void FitWidth(struct Coord *B, int *Err){
-  (*Err) = (*Err) || (((B->x)>>1) < 0) || (((B->x)>>1) >= (int)GlassWidth);
+static int FitsGlass(struct Omnimino *GG, struct FigureMask *M) {
+  return (M->Left >= 0) && ((M->Left + M->Width) <= GlassWidth) &&
+         (M->Bottom >= 0) && ((M->Bottom + M->Height) <= FieldSize);
 }
 
-static void FitHeight(struct Coord *B, int *Err){
-  (*Err) = (*Err) || (((B->y)>>1) < 0) || (((B->y)>>1) >= (int)FieldSize);
+static int Overlaps(struct Omnimino *GG, struct FigureMask *M) {
+  struct RowMask S;
+
+  ShiftMask(M, &S);
+
+  return MaskOverlaps(GlassRow + M->Bottom * RowWords, RowWords, &S);
 }
 
-void FitGlass(struct Coord *B, int *Err){
-  FitWidth(B,Err);
-  FitHeight(B,Err);
+#define Placeable(M) (FitsGlass(GG, M) && (!Overlaps(GG, M)))
+
+
+/**************************************
+
+        Skyline
+
+  Height of every glass column, built
+  on demand after the glass is reloaded
+  and then kept up by placing and
+  discarding rows.
+
+**************************************/
+
+/* Column height is at most Top, the column is scanned down from it */
+
+static unsigned int ColumnHeight(struct Omnimino *GG, unsigned int Column, unsigned int Top) {
+  while ((Top > 0) && (!RowBit(GlassRow + (Top - 1) * RowWords, Column)))
+    Top--;
+
+  return Top;
+}
+
+static void BuildSkyline(struct Omnimino *GG) {
+  unsigned int c;
+
+  for (c = 0; c < GlassWidth; c++)
+    Skyline[c] = ColumnHeight(GG, c, GlassLevel);
+
+  SkylineValid = 1;
 }
 
-void AndGlass(struct Coord *B, int *Err){
-  (*Err) = (*Err) || ( GlassRow[(B->y)>>1] & (1<<((B->x)>>1)) );
+/* Top and bottom cells of a mask column are bit scans, Aperture figures may have empty columns */
+
+static void RaiseSkyline(struct Omnimino *GG, struct FigureMask *M) {
+  unsigned long long Column;
+  unsigned int j, Top;
+
+  for (j = 0; j < M->Width; j++) {
+    if ((Column = M->Bits & (MASK_COLUMN << j)) == 0)
+      continue;
+    Top = M->Bottom + ((63 - __builtin_clzll(Column)) >> 3) + 1;
+    if (Skyline[M->Left + j] < Top)
+      Skyline[M->Left + j] = Top;
+  }
 }
 
-static void PlaceIntoGlass(struct Coord *B, int *V){
-  (void) V;
-  GlassRow[(B->y)>>1] |= (1<<((B->x)>>1));
+/* Full rows are below every column top, the top itself may be gone */
+
+static void LowerSkyline(struct Omnimino *GG, unsigned int FullRowNum) {
+  unsigned int c;
+
+  for (c = 0; c < GlassWidth; c++)
+    Skyline[c] = ColumnHeight(GG, c, Skyline[c] - FullRowNum);
 }
 
-static void CountInner(struct Coord *B, int *Cnt){
-  if (((B->y)>>1) < (int)GlassHeight)
-    (*Cnt)++;
+/*
+  The lowest Bottom where the figure rests on the skyline. The figure
+  falls straight there, unless it is already below the skyline.
+*/
+
+static int SkylineLanding(struct Omnimino *GG, struct FigureMask *M) {
+  unsigned long long Column;
+  unsigned int j;
+  int Land = 0, Rest;
+
+  for (j = 0; j < M->Width; j++) {
+    if ((Column = M->Bits & (MASK_COLUMN << j)) == 0)
+      continue;
+    Rest = (int) Skyline[M->Left + j] - (__builtin_ctzll(Column) >> 3);
+    if (Land < Rest)
+      Land = Rest;
+  }
+
+  return Land;
 }
 
 
-#define FitsGlass(F) (ForEachIn(F, FitGlass, 0) == 0)
-#define Overlaps(F) (ForEachIn(F, AndGlass, 0) != 0)
-#define Placeable(F) (FitsGlass(F) && (!Overlaps(F)))
+static void PlaceIntoGlass(struct Omnimino *GG, struct FigureMask *M) {
+  unsigned int i, *R = GlassRow + M->Bottom * RowWords;
 
+  for (i = 0; i < M->Height; i++, R += RowWords)
+    MaskPlace(R, MaskRow(M, i), M->Left);
 
-static void ClearFullRows(unsigned int From, unsigned int To) {
-  unsigned int r, w, FullRowNum;
+  if ((M->Bottom + M->Height) <= GlassHeight)
+    EmptyCells -= __builtin_popcountll(M->Bits);
+  else if (M->Bottom < (int) GlassHeight) /* the rows above the glass are not counted */
+    EmptyCells -= __builtin_popcountll(M->Bits & ((1ULL << ((GlassHeight - M->Bottom) * 8)) - 1));
+
+  if (SkylineValid)
+    RaiseSkyline(GG, M);
+}
+
+
+/*
+  Full rows among the ones the figure landed on are marked in a bitmap,
+  then the gap is closed from the shorter side: either the rows above
+  move down, or the rows below move up along with the glass bottom
+  GlassRow. The glass loses as many rows on top, so it never outgrows
+  GlassBuf and needs no wrapping.
+*/
+
+static void ClearFullRows(struct Omnimino *GG, unsigned int From, unsigned int To) {
+  unsigned int r, w, Full = 0, FullRowNum;
 
   unsigned int Upper = GlassLevel;
 
@@ -62,65 +142,90 @@ static void ClearFullRows(unsigned int From, unsigned int To) {
   if (To < Upper)
     Upper = To;
 
-  for(r = w = From ; r < Upper ; r++){
-    if (GlassRow[r] != FullRow)
-      GlassRow[w++] = GlassRow[r];
+  for (r = From; r < Upper; r++) { /* at most FigureSize rows */
+    if (RowEqual(GlassRow + r * RowWords, FullRow, RowWords))
+      Full |= 1u << (r - From);
   }
 
-  FullRowNum = r - w;
-
-  if ((int)FullRowNum > 0) {
-/*
-    for(; r < FieldSize ; r++, w++)
-      GlassRow[w] = GlassRow[r];
-*/
+  if (Full == 0)
+    return;
 
-    memmove(GlassRow + w, GlassRow + r, (FieldSize - r) * sizeof(int));
+  FullRowNum = __builtin_popcount(Full);
 
-    GlassHeight -= FullRowNum;
-    FieldSize -= FullRowNum;
-    GlassLevel -= FullRowNum;
+  if (From < (GlassLevel - Upper)) {
+    for (r = w = Upper; r-- > From;) {
+      if (!(Full & (1u << (r - From))))
+        CopyRow(GlassRow + (--w) * RowWords, GlassRow + r * RowWords, RowWords);
+    }
+    memmove(GlassRow + FullRowNum * RowWords, GlassRow, From * RowWords * sizeof(int));
+    GlassRow += FullRowNum * RowWords;
+  } else {
+    for (r = w = From; r < Upper; r++) {
+      if (!(Full & (1u << (r - From))))
+        CopyRow(GlassRow + (w++) * RowWords, GlassRow + r * RowWords, RowWords);
+    }
+    memmove(GlassRow + w * RowWords, GlassRow + Upper * RowWords, (GlassLevel - Upper) * RowWords * sizeof(int));
+    memset(GlassRow + (GlassLevel - FullRowNum) * RowWords, 0, FullRowNum * RowWords * sizeof(int));
   }
+
+  GlassHeight -= FullRowNum;
+  FieldSize -= FullRowNum;
+  GlassLevel -= FullRowNum;
+
+  if (SkylineValid)
+    LowerSkyline(GG, FullRowNum);
 }
 
 
-static void Drop(struct Coord **FigN) {
-  unsigned int Top, Bottom, y;
+/* Moves the figure down to where it would be placed */
 
-  CopyFigure(FigureBuf, FigN);
-  y = ForEachIn(FigureBuf, FindBottom, INT_MAX) & (~1);
+void Fall(struct Omnimino *GG, struct FigureMask *M) {
+  struct RowMask S;
+  int Bottom;
 
   if(Gravity){
-    Bottom = y >> 1;
     if (SingleLayer) {
-      for (y = Bottom; y > 0; y--) {
-        ForEachIn(FigureBuf, AddY, -2);
-        if (Overlaps(FigureBuf)) {
-          ForEachIn(FigureBuf, AddY, 2);
+      if (!SkylineValid)
+        BuildSkyline(GG);
+      Bottom = SkylineLanding(GG, M);
+      if (Bottom <= M->Bottom) {
+        M->Bottom = Bottom;
+        return;
+      }
+    }
+    ShiftMask(M, &S); /* once for the whole fall */
+    if (SingleLayer) {
+      while (M->Bottom > 0) {
+        M->Bottom--;
+        if (MaskOverlaps(GlassRow + M->Bottom * RowWords, RowWords, &S)) {
+          M->Bottom++;
           break;
         }
       }
     } else {
-      ForEachIn(FigureBuf, AddY, -y);
-      for (y = 0; (y < Bottom) && Overlaps(FigureBuf); y++) {
-        ForEachIn(FigureBuf,AddY,2);
-      }
+      for (Bottom = M->Bottom, M->Bottom = 0;
+           (M->Bottom < Bottom) && MaskOverlaps(GlassRow + M->Bottom * RowWords, RowWords, &S);
+           M->Bottom++);
     }
-  } else {
-    y >>= 1;
   }
+}
 
-  ForEachIn(FigureBuf,PlaceIntoGlass,0);
-  EmptyCells -= ForEachIn(FigureBuf, CountInner, 0);
-  Top = (ForEachIn(FigureBuf, FindTop, INT_MIN) >> 1) + 1;
+
+static void Drop(struct Omnimino *GG, struct FigureMask *M) {
+  unsigned int Top;
+
+  Fall(GG, M);
+
+  PlaceIntoGlass(GG, M);
+  Top = M->Bottom + M->Height;
   if (Top > GlassLevel)
     GlassLevel = Top;
   if (DiscardFullRows)
-    ClearFullRows(y, Top);
+    ClearFullRows(GG, M->Bottom, Top);
 }
 
 
-static void Deploy(struct Coord **F) {
+void Deploy(struct Omnimino *GG, struct Coord **F) {
   struct Coord C;
 
   Normalize(F, &C);
@@ -130,14 +235,14 @@ static void Deploy(struct Coord **F) {
 }
 
 
-static void CheckGameState(void) {
+static void CheckGameState(struct Omnimino *GG, struct FigureMask *M) {
   switch(Goal){
     case TOUCH_GOAL:
-      if ((ForEachIn(FigureBuf, FindBottom, INT_MAX) >> 1) == 0)
+      if (M->Bottom == 0)
         GoalReached = 1;
       break;
     case FLAT_GOAL:
-      if ((GlassLevel == 0) || (GlassRow[GlassLevel - 1] == FullRow))
+      if ((GlassLevel == 0) || RowEqual(GlassRow + (GlassLevel - 1) * RowWords, FullRow, RowWords))
         GoalReached = 1;
       break;
     default:
@@ -150,174 +255,372 @@ static void CheckGameState(void) {
 }
 
 
-static void RewindGlassState(void) {
-  unsigned int i;
+/* Move is allowed where the player could bring the figure */
 
-  for (i=0; i < FillLevel; i++)
-    GlassRow[i] = FillBuf[i];
+int CanMove(struct Omnimino *GG, struct FigureMask *M) {
+  return FitsGlass(GG, M) && ((!SingleLayer) || (!Overlaps(GG, M)));
+}
 
-  GlassHeight=GlassHeightBuf;
+int CanDrop(struct Omnimino *GG, struct FigureMask *M) {
+  return Placeable(M);
+}
+
+void DropFigure(struct Omnimino *GG, struct FigureMask *M) {
+  Drop(GG, M);
+  CheckGameState(GG, M);
+}
+
+
+/**************************************
+
+        Glass state checkpoints
+
+**************************************/
+
+#define CHECKPOINT_LEN ((GlassHeightBuf + FigureSize + 1) * RowWords + 3)
+
+static void StoreCheckpoint(struct Omnimino *GG) {
+  unsigned int *S = Checkpoint + CheckpointNum * CHECKPOINT_LEN;
+
+  S[0] = GlassHeight;
+  S[1] = GlassLevel;
+  S[2] = EmptyCells;
+  memcpy(S + 3, GlassRow, GlassLevel * RowWords * sizeof(int));
+
+  CheckpointNum++;
+}
+
+static void RestoreCheckpoint(struct Omnimino *GG, unsigned int N) {
+  unsigned int *S = Checkpoint + N * CHECKPOINT_LEN;
+
+  GlassHeight = S[0];
   FieldSize = GlassHeight + FigureSize + 1;
+  GlassLevel = S[1];
+  EmptyCells = S[2];
+  GlassRow = GlassBuf;
+  SkylineValid = 0;
+  memcpy(GlassRow, S + 3, GlassLevel * RowWords * sizeof(int));
+  memset(GlassRow + GlassLevel * RowWords, 0, (FieldSize - GlassLevel) * RowWords * sizeof(int));
 
-  for (; i < FieldSize; i++)
-    GlassRow[i] = 0;
+  CurFigure = Figure + N * CHECKPOINT_STEP;
+}
+
+/* Figures starting from F were changed, glass states after F are stale */
+
+static void DropCheckpoints(struct Omnimino *GG, struct Coord **F) {
+  unsigned int Valid = (F - Figure) / CHECKPOINT_STEP + 1;
+
+  if (CheckpointNum > Valid)
+    CheckpointNum = Valid;
+}
+
+
+static void RewindGlassState(struct Omnimino *GG) {
+  unsigned int N;
 
-  EmptyCells = TotalArea;
-  GlassLevel = FillLevel;
-  CurFigure = Figure;
   FigureBuf = LastFigure + 1;
   *FigureBuf = *LastFigure;
   GameOver = 0;
   GoalReached = 0;
+
+  if (CheckpointNum > 0) {
+    N = (NextFigure - Figure) / CHECKPOINT_STEP;
+    if (N >= CheckpointNum)
+      N = CheckpointNum - 1;
+    RestoreCheckpoint(GG, N);
+    return;
+  }
+
+  GlassHeight=GlassHeightBuf;
+  FieldSize = GlassHeight + FigureSize + 1;
+
+  GlassRow = GlassBuf;
+  SkylineValid = 0;
+  memcpy(GlassRow, FillBuf, FillLevel * RowWords * sizeof(int));
+  memset(GlassRow + FillLevel * RowWords, 0, (FieldSize - FillLevel) * RowWords * sizeof(int));
+
+  EmptyCells = TotalArea;
+  GlassLevel = FillLevel;
+  CurFigure = Figure;
 }
 
-void GetGlassState(struct Omnimino *G) {
-  GG = G;
+void GetGlassState(struct Omnimino *GG) {
+  struct FigureMask M;
 
   if (CurFigure > NextFigure)
-    RewindGlassState();
+    RewindGlassState(GG);
 
   while (CurFigure < NextFigure) {
-    if (!Placeable(CurFigure)) {
+    if ((CurFigure - Figure) == (int)(CheckpointNum * CHECKPOINT_STEP))
+      StoreCheckpoint(GG);
+    GetMask(CurFigure, &M);
+    if (!Placeable(&M)) {
       NextFigure = CurFigure;
       LastTouched = CurFigure - 1;
       break;
     }
-    Drop(CurFigure++);
-    CheckGameState();
+    Drop(GG, &M);
+    CurFigure++;
+    CheckGameState(GG, &M);
     if (GameOver)
       NextFigure = CurFigure;
   }
 
   if(CurFigure > LastTouched){
-    Deploy(CurFigure);
+    DropCheckpoints(GG, CurFigure);
+    Deploy(GG, CurFigure);
     LastTouched = CurFigure;
   }
 }
 
+int GetScore(struct Omnimino *GG) {
+  int Score = EmptyCells;
+
+  if (Goal != FILL_GOAL) {
+    Score = TotalArea;
+    if (GoalReached)
+      Score -= EmptyCells;
+  }
+
+  return Score;
+}
+
 /**************************************
 
-           PlayGame
+           Figure queue
+
+  Skipping cycles the figures from
+  CurFigure on. They are copied aside
+  once and only the queue shift moves,
+  the one shown is copied to CurFigure.
+  Figure[] is put in order again before
+  any other figure is needed.
 
 **************************************/
 
-static int KeepPlaying;
+static struct Coord *QueuedFigure(struct Omnimino *GG, unsigned int N, unsigned int *Len) {
+  unsigned int i = (N + QueueShift) % QueueLen;
+
+  *Len = QueueStart[i + 1] - QueueStart[i];
+
+  return QueueBlock + QueueStart[i];
+}
+
+/* CurFigure may have been deployed and moved since it was shown */
+
+static void StoreQueueHead(struct Omnimino *GG) {
+  unsigned int Len;
+  struct Coord *B = QueuedFigure(GG, 0, &Len);
+
+  memcpy(B, CurFigure[0], Len * sizeof(struct Coord));
+}
+
+/* Returns the figures number to cycle */
+
+static unsigned int OpenQueue(struct Omnimino *GG) {
+  unsigned int i;
+
+  if (QueueLen) {
+    StoreQueueHead(GG);
+  } else if (CurFigure < LastFigure) {
+    QueueLen = LastFigure - CurFigure;
+    QueueShift = 0;
+    memcpy(QueueBlock, CurFigure[0], (LastFigure[0] - CurFigure[0]) * sizeof(struct Coord));
+    for (i = 0; i <= QueueLen; i++)
+      QueueStart[i] = CurFigure[i] - CurFigure[0];
+  }
+
+  return QueueLen;
+}
+
+static void ShowQueueHead(struct Omnimino *GG) {
+  unsigned int Len;
+  struct Coord *B;
+
+  if (QueueLen) {
+    B = QueuedFigure(GG, 0, &Len);
+    memcpy(CurFigure[0], B, Len * sizeof(struct Coord));
+    CurFigure[1] = CurFigure[0] + Len; /* figures past CurFigure are stale */
+  }
+}
+
+static void SettleQueue(struct Omnimino *GG) {
+  unsigned int i, Len;
+  struct Coord *B;
+
+  if (QueueLen) {
+    StoreQueueHead(GG);
+    for (i = 0; i < QueueLen; i++) {
+      B = QueuedFigure(GG, i, &Len);
+      memcpy(CurFigure[i], B, Len * sizeof(struct Coord));
+      CurFigure[i + 1] = CurFigure[i] + Len;
+    }
+    QueueLen = 0;
+  }
+}
+
+/* Blocks of figure F as the player sees it */
+
+void PeekFigure(struct Omnimino *GG, struct Coord **F, struct Coord **View) {
+  unsigned int Len;
+
+  if (QueueLen && (F > CurFigure)) {
+    View[0] = QueuedFigure(GG, F - CurFigure, &Len);
+    View[1] = View[0] + Len;
+  } else {
+    View[0] = F[0];
+    View[1] = F[1];
+  }
+}
+
+
+/**************************************
+
+           PlayGame
 
-static void ExitWithSave(void){
+**************************************/
+
+static void ExitWithSave(struct Omnimino *GG){
   KeepPlaying = 0;
 }
 
-static void ExitWithoutSave(void){
+static void ExitWithoutSave(struct Omnimino *GG){
   GameModified=0;
   KeepPlaying = 0;
 }
 
-static void Attempt(bfunc F, int V) {
+/* Moves are tried on the packed orientation masks, blocks change only when taken */
+
+static void CommitMove(struct Omnimino *GG, int Index, struct Coord *C) {
+  Orient.Index = Index;
+  Orient.C = *C;
+  PlaceOrientation(&Orient, Index, C, CurFigure);
+  DropCheckpoints(GG, CurFigure);
+  LastTouched = CurFigure;
+  GameModified=1;
+}
+
+static void AttemptShift(struct Omnimino *GG, int dx, int dy) {
   if (!GameOver) {
+    struct FigureMask M;
     struct Coord C;
 
-    CopyFigure(FigureBuf, CurFigure);
-    Normalize(FigureBuf, &C);
-    ForEachIn(FigureBuf, F, V);
-    ForEachIn(FigureBuf, AddX, C.x);
-    ForEachIn(FigureBuf, AddY, C.y);
-    if(FitsGlass(FigureBuf) && ((!SingleLayer) || (!Overlaps(FigureBuf)))){
-      CopyFigure(CurFigure,FigureBuf);
-      LastTouched = CurFigure;
-      GameModified=1;
-    }
+    if (!OrientedAs(CurFigure, &Orient))
+      BuildOrientations(CurFigure, &Orient);
+    C.x = Orient.C.x + dx;
+    C.y = Orient.C.y + dy;
+    OrientMask(&Orient, Orient.Index, &C, &M);
+    if(CanMove(GG, &M))
+      CommitMove(GG, Orient.Index, &C);
   }
 }
 
-static void MoveCurLeft(void){
-  Attempt(AddX, -2);
+static void AttemptTurn(struct Omnimino *GG, int Turn) {
+  if (!GameOver) {
+    struct FigureMask M;
+    struct Coord C;
+    int Index;
+
+    if (!OrientedAs(CurFigure, &Orient))
+      BuildOrientations(CurFigure, &Orient);
+    Index = TurnCenter(&Orient, Turn, &C);
+    OrientMask(&Orient, Index, &C, &M);
+    if(CanMove(GG, &M))
+      CommitMove(GG, Index, &C);
+  }
+}
+
+static void MoveCurLeft(struct Omnimino *GG){
+  AttemptShift(GG, -2, 0);
 }
 
-static void MoveCurRight(void){
-  Attempt(AddX, 2);
+static void MoveCurRight(struct Omnimino *GG){
+  AttemptShift(GG, 2, 0);
 }
 
-static void MoveCurDown(void){
+static void MoveCurDown(struct Omnimino *GG){
   if (!Gravity)
-    Attempt(AddY, -2);
+    AttemptShift(GG, 0, -2);
 }
 
-static void MoveCurUp(void){
+static void MoveCurUp(struct Omnimino *GG){
   if (!Gravity)
-    Attempt(AddY, 2);
+    AttemptShift(GG, 0, 2);
 }
 
-static void RotateCurCW(void){
-  Attempt(RotCW, 0);
+static void RotateCurCW(struct Omnimino *GG){
+  AttemptTurn(GG, TURN_CW);
 }
 
-static void RotateCurCCW(void){
-  Attempt(RotCCW, 0);
+static void RotateCurCCW(struct Omnimino *GG){
+  AttemptTurn(GG, TURN_CCW);
 }
 
-static void MirrorCurVert(void){
-  Attempt(NegX, 0);
+static void MirrorCurVert(struct Omnimino *GG){
+  AttemptTurn(GG, TURN_MIRROR);
 }
 
-static void DropCur(void){
-  if((!GameOver) && Placeable(CurFigure)) {
+static void DropCur(struct Omnimino *GG){
+  struct FigureMask M;
+
+  SettleQueue(GG);
+  GetMask(CurFigure, &M);
+  if((!GameOver) && Placeable(&M)) {
     NextFigure=CurFigure+1;
   }
 }
 
-static void UndoFigure(void) {
+static void UndoFigure(struct Omnimino *GG) {
+  SettleQueue(GG);
   if (CurFigure > Figure)
     NextFigure = CurFigure - 1;
 }
 
-static void RedoFigure(void) {
+static void RedoFigure(struct Omnimino *GG) {
+  SettleQueue(GG);
   if (CurFigure < LastTouched)
     NextFigure = CurFigure + 1;
 }
 
-static void Rewind(void) {
+static void Rewind(struct Omnimino *GG) {
+  SettleQueue(GG);
   NextFigure = Figure;
 }
 
-static void SkipForward(void) {
-  struct Coord **F;
-
+static void SkipForward(struct Omnimino *GG) {
   if (!FixedSequence) {
-    CopyFigure(FigureBuf, CurFigure);
-    memmove(CurFigure[0], CurFigure[1], (LastFigure[0] - CurFigure[1]) * sizeof(struct Coord));
-    for (F = CurFigure + 1; F < LastFigure; F++)
-      F[0] = F[-1] + (F[1] - F[0]);
-    CopyFigure(LastFigure - 1, FigureBuf);
+    if (OpenQueue(GG))
+      QueueShift = (QueueShift + 1) % QueueLen;
+    ShowQueueHead(GG);
 
+    DropCheckpoints(GG, CurFigure);
     LastTouched = CurFigure - 1;
   }
 }
 
-static void SkipBackward(void) {
-  struct Coord **F;
-
+static void SkipBackward(struct Omnimino *GG) {
   if (!FixedSequence) {
-    CopyFigure(FigureBuf, LastFigure - 1);
-    for (F = LastFigure - 1; F > CurFigure; F--)
-      F[0] = F[1] - (F[0] - F[-1]);
-    memmove(CurFigure[1], CurFigure[0], (LastFigure[0] - CurFigure[1]) * sizeof(struct Coord));
-    CopyFigure(CurFigure, FigureBuf);
+    if (OpenQueue(GG))
+      QueueShift = (QueueShift + QueueLen - 1) % QueueLen;
+    ShowQueueHead(GG);
 
+    DropCheckpoints(GG, CurFigure);
     LastTouched = CurFigure - 1;
   }
 }
 
-static void LastPlayed(void) {
+static void LastPlayed(struct Omnimino *GG) {
+  SettleQueue(GG);
   NextFigure = LastTouched;
 }
 
-static void RefreshScreen(void) {
-
+static void RefreshScreen(struct Omnimino *GG) {
+  (void) GG;
 }
 
 static struct KBinding {
   int Key;
-  void (*Action)(void);
+  void (*Action)(struct Omnimino *);
 } KBindList[] = {
   {'q', ExitWithoutSave},
   {'x', ExitWithSave},
@@ -345,36 +648,31 @@ static struct KBinding {
   {0, NULL}
 };
 
-static int ExecuteCmd(void){
-  int Key;
+/* Returns 0 if Key is not bound */
+
+int ExecuteKey(struct Omnimino *GG, int Key){
   struct KBinding *P;
-  void (*Func)(void);
 
-  KeepPlaying = 1;
+  for(P=KBindList;(P->Action!=NULL)&&(Key!=(P->Key));P++);
 
-  do {
-    Key=ReadKey();
-    for(P=KBindList;((Func=(P->Action))!=NULL)&&(Key!=(P->Key));P++);
-  } while(Func==NULL);
+  if (P->Action == NULL)
+    return 0;
 
-  (*Func)();
+  (*(P->Action))(GG);
 
-  return KeepPlaying;
+  return 1;
 }
 
-int PlayGame(struct Omnimino *G){
-
-  GG = G;
+static int ExecuteCmd(struct Omnimino *GG){
+  KeepPlaying = 1;
 
-  CurFigure = NextFigure + 1; /* forces RewindGlassState() */
+  while (!ExecuteKey(GG, ReadKey()));
 
-  OpenScreen();
+  return KeepPlaying;
+}
 
-  do
-    GetGlassState(G);
-  while (ShowScreen(G) && ExecuteCmd());
-
-  CloseScreen();
+int EndGame(struct Omnimino *GG){
+  SettleQueue(GG);
 
   if (GameModified) {
     if ((GameType == 1) && (strcmp(ParentName, "none") == 0))
@@ -385,4 +683,17 @@ int PlayGame(struct Omnimino *G){
   return GameModified;
 }
 
+int PlayGame(struct Omnimino *GG){
+
+  CurFigure = NextFigure + 1; /* forces RewindGlassState() */
+
+  OpenScreen();
+
+  do
+    GetGlassState(GG);
+  while (ShowScreen(GG) && ExecuteCmd(GG));
 
+  CloseScreen();
+
+  return EndGame(GG);
+}
@@ -4,7 +4,16 @@
 
 #include "omnitype.h"
 
+void Fall(struct Omnimino *G, struct FigureMask *M);
+void Deploy(struct Omnimino *G, struct Coord **F);
+int CanMove(struct Omnimino *G, struct FigureMask *M);
+int CanDrop(struct Omnimino *G, struct FigureMask *M);
+void DropFigure(struct Omnimino *G, struct FigureMask *M);
 void GetGlassState(struct Omnimino *G);
+int GetScore(struct Omnimino *G);
+void PeekFigure(struct Omnimino *G, struct Coord **F, struct Coord **View);
+int ExecuteKey(struct Omnimino *G, int Key);
+int EndGame(struct Omnimino *G);
 int PlayGame(struct Omnimino *G);
 
 #endif
@@ -0,0 +1,145 @@
+#define _GNU_SOURCE 1
+
+#include <features.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "omnigame.h"
+#include "omniload.h"
+#include "omnisave.h"
+#include "omninew.h"
+#include "omnigen.h"
+
+/**************************************
+
+         Bulk game generation
+
+  Count games are made from one preset
+  by Jobs threads, each with its own
+  game and figures generator. Seed i
+  goes to game i when Seed is given,
+  fresh seeds are taken otherwise.
+  Every game is saved as played from
+  its first figure, and "seed name" is
+  written out in completion order.
+
+**************************************/
+
+struct Generation {
+  struct Omnimino *Preset;    /* read only */
+  FILE *fout;
+  unsigned long Count;
+  unsigned long Next;         /* game number to be taken */
+  unsigned long Failed;
+  unsigned long long Seed;
+  unsigned int Generator;
+};
+
+
+static void Restore(struct Omnimino *G, struct Omnimino *Preset) {
+  G->P = Preset->P;
+  G->C = Preset->C;
+  G->V.GameType = 2;
+  G->V.RecordFormat = Preset->V.RecordFormat;
+  memcpy(G->M.FillBuf, Preset->M.FillBuf, Preset->P.FillLevel * Preset->C.RowWords * sizeof(int));
+}
+
+
+static void *GenerateWorker(void *Arg) {
+  struct Generation *W = Arg;
+  struct Omnimino Game;
+  unsigned long i;
+
+  InitGame(&Game);
+
+  while ((i = __atomic_fetch_add(&W->Next, 1, __ATOMIC_RELAXED)) < W->Count) {
+    Restore(&Game, W->Preset);
+
+    if (NewGame(&Game, W->Seed ? (W->Seed + i) : 0, W->Generator) == 0) {
+      Game.V.CurFigure = Game.D.NextFigure + 1; /* forces RewindGlassState() */
+      GetGlassState(&Game);
+      EndGame(&Game);
+      SaveGame(&Game);
+    } else {
+      Game.V.GameType = 3;
+    }
+
+    if (Game.V.GameType == 3) {
+      __atomic_fetch_add(&W->Failed, 1, __ATOMIC_RELAXED);
+      fprintf(W->fout, "%llu error %s\n", Game.D.Seed, Game.S.MsgBuf);
+    } else {
+      fprintf(W->fout, "%llu %s\n", Game.D.Seed, Game.S.GameName);
+    }
+  }
+
+  free(Game.M.Figure);
+
+  return NULL;
+}
+
+
+/**************************************
+
+            GenerateGames
+
+**************************************/
+
+int GenerateGames(char *Name, unsigned long Count, unsigned long long Seed, unsigned int Generator,
+                  unsigned int Jobs, FILE *fout) {
+  struct Generation W;
+  struct Omnimino Preset;
+  pthread_t *Worker = NULL;
+  unsigned int i, Started = 0;
+
+  InitGame(&Preset);
+
+  if (LoadGame(&Preset, Name) != 0) {
+    fprintf(fout, "error %s\n", Preset.S.MsgBuf);
+    free(Preset.M.Figure);
+    return 1;
+  }
+
+  if (Preset.V.GameType != 2) {
+    fprintf(fout, "error %s is not a preset.\n", Name);
+    free(Preset.M.Figure);
+    return 1;
+  }
+
+  if (Jobs == 0) {
+    long N = sysconf(_SC_NPROCESSORS_ONLN);
+    Jobs = (N > 0) ? N : 1;
+  }
+  if (Jobs > Count)
+    Jobs = Count;
+
+  W.Preset = &Preset;
+  W.fout = fout;
+  W.Count = Count;
+  W.Next = 0;
+  W.Failed = 0;
+  W.Seed = Seed;
+  W.Generator = Generator;
+
+  if (Jobs > 1)
+    Worker = calloc(Jobs - 1, sizeof(pthread_t));
+
+  for (Started = 0; Worker && (Started + 1 < Jobs); Started++) {
+    if (pthread_create(Worker + Started, NULL, GenerateWorker, &W) != 0)
+      break;
+  }
+
+  GenerateWorker(&W); /* the calling thread is one of the jobs */
+
+  for (i = 0; i < Started; i++)
+    pthread_join(Worker[i], NULL);
+
+  free(Worker);
+  free(Preset.M.Figure);
+
+  return W.Failed != 0;
+}
+
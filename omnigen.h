@@ -0,0 +1,13 @@
+#ifndef _OMNIGEN_H
+
+#define _OMNIGEN_H 1
+
+#include <stdio.h>
+
+#include "omnitype.h"
+
+int GenerateGames(char *Name, unsigned long Count, unsigned long long Seed, unsigned int Generator,
+                  unsigned int Jobs, FILE *fout);
+
+#endif
+
@@ -7,40 +7,209 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <string.h>
+#include <limits.h>
 #include <time.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 
 #include "omnitype.h"
 
 #include "md5hash.h"
 #include "omnifunc.h"
 #include "omnimem.h"
-
-static struct Omnimino *GG;
+#include "omniread.h"
+#include "omnirow.h"
 
 #include "omnimino.def"
 
 /**************************************
 
-           LoadGame
+          Text record scanner
+
+  Numbers are read as strtol() and
+  strtoull() read them in the C locale:
+  digits are found 16 bytes at a time,
+  up to 8 of them are converted at once,
+  line ends are found 16 bytes at a time
+  too. Loads may run up to 15 bytes past
+  the '\0', into the RECORD_PAD of the
+  record buffer.
+
+**************************************/
+
+static inline int IsDigit(char c) {
+  return (unsigned char) (c - '0') < 10;
+}
+
+
+/* Digits at P, 16 at most are counted */
+
+static unsigned int DigitRun(const char *P) {
+#ifdef __SSE2__
+  __m128i D = _mm_sub_epi8(_mm_loadu_si128((const __m128i *) P), _mm_set1_epi8('0'));
+  unsigned int M = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(D, _mm_set1_epi8(9)), D));
+
+  return __builtin_ctz(~M);
+#else
+  unsigned int n;
+
+  for (n = 0; (n < 16) && IsDigit(P[n]); n++);
+
+  return n;
+#endif
+}
+
+
+/* N (1..8) digits at P, the first one in the lowest byte */
+
+static unsigned long long Digits8(const char *P, unsigned int N) {
+  unsigned long long W = 0;
+
+  memcpy(&W, P, 8);
+
+  W = (W - 0x3030303030303030ULL) << (8 * (8 - N)); /* bytes past N borrow upwards only */
+  W = ((W * 10) + (W >> 8)) & 0x00ff00ff00ff00ffULL;
+  W = ((W * 100) + (W >> 16)) & 0x0000ffff0000ffffULL;
+  W = ((W * 10000) + (W >> 32)) & 0xffffffffULL;
+
+  return W;
+}
+
+
+/* Returns P if there is no number */
+
+static char *ScanNumber(char *P, unsigned long long *Mag, int *Neg, int *Over) {
+  char *S = P;
+  unsigned int n;
+
+  while ((*S == ' ') || ((unsigned char) (*S - '\t') < 5)) /* \t \n \v \f \r */
+    S++;
+
+  *Neg = (*S == '-');
+  if ((*S == '-') || (*S == '+'))
+    S++;
+
+  *Over = 0;
+
+  if ((n = DigitRun(S)) == 0)
+    return P;
+
+  if (n <= 8) {
+    *Mag = Digits8(S, n);
+    return S + n;
+  }
+
+  for (*Mag = 0; IsDigit(*S); S++) {
+    if (__builtin_mul_overflow(*Mag, 10, Mag) || __builtin_add_overflow(*Mag, (unsigned int) (*S - '0'), Mag))
+      *Over = 1;
+  }
+
+  return S;
+}
+
+
+/* Past the next '\n', or at the '\0' */
+
+static char *SkipLine(char *P) {
+#ifdef __SSE2__
+  for (;;) {
+    __m128i V = _mm_loadu_si128((const __m128i *) P);
+    unsigned int M = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(V, _mm_set1_epi8('\n')),
+                                                    _mm_cmpeq_epi8(V, _mm_setzero_si128())));
+    if (M) {
+      P += __builtin_ctz(M);
+      return *P ? P + 1 : P;
+    }
+    P += 16;
+  }
+#else
+  for (;;) {
+    if (*P == '\0')
+      return P;
+    if (*P++ == '\n')
+      return P;
+  }
+#endif
+}
+
+
+/**************************************
+
+        Hashing while reading
+
+  A text record named by its hash is
+  hashed a chunk ahead of the parser,
+  which then finds the chunk in cache,
+  so the record is fetched from memory
+  once. Other names can never match.
 
 **************************************/
 
+#define HASH_CHUNK 16384
 
-static char *LoadPtr;
+static void HashAhead(struct Omnimino *GG) {
+  size_t Len;
 
+  while (LoadHash && (HashedPtr < LoadEnd) && (HashedPtr < LoadPtr + HASH_CHUNK / 2)) {
+    Len = LoadEnd - HashedPtr;
+    if (Len > HASH_CHUNK)
+      Len = HASH_CHUNK;
+    md5hash_update(LoadHash, HashedPtr, Len);
+    HashedPtr += Len;
+  }
+}
 
-static int ReadInt(int *V, int Delim) {
+
+static void HashRest(struct Omnimino *GG, char *Name) {
+  md5hash_update(LoadHash, HashedPtr, LoadEnd - HashedPtr);
+  md5hash_final(LoadHash, Name);
+  HashedPtr = LoadEnd;
+  LoadHash = NULL;
+}
+
+
+static int IsHashName(char *Name) {
+  int i;
+
+  for (i = 0; i < MD5HASH_LEN; i++) {
+    if (!(IsDigit(Name[i]) || ((Name[i] >= 'a') && (Name[i] <= 'f'))))
+      return 0;
+  }
+
+  return strcmp(Name + MD5HASH_LEN, ".mino") == 0;
+}
+
+
+/**************************************
+
+           LoadGame
+
+**************************************/
+
+
+static int ReadInt(struct Omnimino *GG, int *V, int Delim) {
+  unsigned long long Mag;
+  int Neg, Over;
   char *EndPtr;
 
-  *V = (int)strtol(LoadPtr, &EndPtr, 10);
+  HashAhead(GG);
+
+  EndPtr = ScanNumber(LoadPtr, &Mag, &Neg, &Over);
+
+  *V = 0;
   if (LoadPtr == EndPtr)
     return 1;
 
+  if (Over || (Mag > (Neg ? (unsigned long long) LONG_MAX + 1 : (unsigned long long) LONG_MAX)))
+    *V = (int) (Neg ? LONG_MIN : LONG_MAX); /* strtol() saturates */
+  else
+    *V = (int) (long) (Neg ? 0 - Mag : Mag);
+
   if (Delim != 0) {
     if (*EndPtr++ != Delim)
       return 1;
   } else {
-    while (*EndPtr && (*EndPtr++ != '\n'));
+    EndPtr = SkipLine(EndPtr);
   }
 
   LoadPtr = EndPtr;
@@ -49,10 +218,31 @@ static int ReadInt(int *V, int Delim) {
 }
 
 
-static int ReadBlockAddr(struct Coord **P, int Delim) {
+static int ReadLong(struct Omnimino *GG, unsigned long long *V) {
+  unsigned long long Mag;
+  int Neg, Over;
+  char *EndPtr;
+
+  HashAhead(GG);
+
+  EndPtr = ScanNumber(LoadPtr, &Mag, &Neg, &Over);
+
+  *V = 0;
+  if (LoadPtr == EndPtr)
+    return 1;
+
+  *V = Over ? ULLONG_MAX : (Neg ? 0 - Mag : Mag);
+
+  LoadPtr = SkipLine(EndPtr);
+
+  return 0; 
+}
+
+
+static int ReadBlockAddr(struct Omnimino *GG, struct Coord **P, int Delim) {
   int V;
 
-  if (ReadInt(&V, Delim) != 0)
+  if (ReadInt(GG, &V, Delim) != 0)
     return 1;
 
   *P = Block + V;
@@ -61,10 +251,10 @@ static int ReadBlockAddr(struct Coord **P, int Delim) {
 }
 
 
-static int ReadPointer(struct Coord ***P, int Delim) {
+static int ReadPointer(struct Omnimino *GG, struct Coord ***P, int Delim) {
   int V;
 
-  if (ReadInt(&V, Delim) != 0)
+  if (ReadInt(GG, &V, Delim) != 0)
     return 1;
 
   *P = Figure + V;
@@ -73,28 +263,33 @@ static int ReadPointer(struct Coord ***P, int Delim) {
 }
 
 
-static void ReadString(char *S) {
-  int i;
+static void ReadString(struct Omnimino *GG, char *S) {
+  char *End;
+  size_t Len;
 
-  for (i = 0; *LoadPtr; LoadPtr++) {
-    if (*LoadPtr == '\n') {
-      LoadPtr++; break;
-    }
-    if (i < OM_STRLEN) {
-      *S++ = *LoadPtr;
-    }
-  }
+  HashAhead(GG);
+
+  End = SkipLine(LoadPtr);
+  Len = End - LoadPtr;
 
-  *S = '\0';
+  if ((Len > 0) && (End[-1] == '\n'))
+    Len--;
+  if (Len > OM_STRLEN)
+    Len = OM_STRLEN;
+
+  memcpy(S, LoadPtr, Len);
+  S[Len] = '\0';
+
+  LoadPtr = End;
 }
 
 
-static int ReadParameters(void) {
+static int ReadParameters(struct Omnimino *GG) {
   unsigned int i;
   unsigned int *Par = (unsigned int *) (&(GG->P));
 
   for (i = 0; i < PARNUM; i++, Par++){
-    if(ReadInt((int *)Par, 0) != 0) {
+    if(ReadInt(GG, (int *)Par, 0) != 0) {
       snprintf(MsgBuf, OM_STRLEN, "[%d] Parameter load error.", i+1);
       return 1;
     }
@@ -103,7 +298,7 @@ static int ReadParameters(void) {
   return 0;
 }
 
-int CheckParameters(void){
+int CheckParameters(struct Omnimino *GG){
   if (Aperture > MAX_FIGURE_SIZE){
     snprintf(MsgBuf, OM_STRLEN, "[1] Aperture (%d) > MAX_FIGURE_SIZE (%d)", Aperture, MAX_FIGURE_SIZE);
   } else if (Metric > 1){
@@ -142,7 +337,10 @@ int CheckParameters(void){
     } else {
       unsigned int i, Area;
 
-      FullRow = ((1 << (GlassWidth - 1)) << 1) - 1;
+      RowWords = RowWordsOf(GlassWidth);
+      memset(FullRow, 0, sizeof(FullRow));
+      for (i = 0; i < GlassWidth; i++)
+        SetRowBit(FullRow, i);
       TotalArea = GlassWidth * GlassHeightBuf;
 
       for (Area = 0, i = 0; i < Aperture; i++)
@@ -160,38 +358,32 @@ int CheckParameters(void){
 }
 
 
-static unsigned int CountUnits(unsigned int R){
-  unsigned int n;
+/* Wide rows are RowWords numbers delimited with , lower words first */
 
-  for (n = 0; R; R >>= 1)
-    n += R & 1;
+static int ReadGlassFill(struct Omnimino *GG) {
+  unsigned int i, j, *R;
 
-  return n;
-}
-
-
-static int ReadGlassFill(void) {
-  unsigned int i;
-
-  for (i = 0; i < FillLevel; i++) {
-    if (ReadInt((int *)(FillBuf + i), ';') != 0) {
-      snprintf(MsgBuf, OM_STRLEN, "[17] GlassRow[%d] load error.", i); return 1;
+  for (i = 0, R = FillBuf; i < FillLevel; i++, R += RowWords) {
+    for (j = 0; j < RowWords; j++) {
+      if (ReadInt(GG, (int *)(R + j), (j + 1 < RowWords) ? ',' : ';') != 0) {
+        snprintf(MsgBuf, OM_STRLEN, "[17] GlassRow[%d] load error.", i); return 1;
+      }
+      R[j] &= FullRow[j];
     }
-    FillBuf[i] &= FullRow;
   }
 
   return 0;
 }
 
 
-static int CheckGlassFill(void) {
+static int CheckGlassFill(struct Omnimino *GG) {
   unsigned int i, Units;
 
   for (i = 0; i < FillLevel; i++) {
-    Units = CountUnits(FillBuf[i]);
+    Units = RowCount(FillBuf + i * RowWords, RowWords);
     if (FillRatio != 0) {
       if (Units != FillRatio) {
-        snprintf(MsgBuf, OM_STRLEN, "[17] Wrong GlassRow[%d] = %d.", i, FillBuf[i]); return 1;
+        snprintf(MsgBuf, OM_STRLEN, "[17] Wrong GlassRow[%d] = %d.", i, FillBuf[i * RowWords]); return 1;
       }
     }
     TotalArea -= Units;
@@ -201,12 +393,12 @@ static int CheckGlassFill(void) {
 }
 
 
-static int ReadFigures(void) {
+static int ReadFigures(struct Omnimino *GG) {
   unsigned int i;
   struct Coord **F;
 
   for (i = 0, F = Figure; F <= LastFigure; F++, i++) {
-    if(ReadBlockAddr(F, ';') != 0){
+    if(ReadBlockAddr(GG, F, ';') != 0){
       snprintf(MsgBuf, OM_STRLEN, "[18] Figure[%d] load error.", i); return 1;
     }
   }
@@ -215,7 +407,7 @@ static int ReadFigures(void) {
 }
 
 
-static int CheckFigures(void) {
+static int CheckFigures(struct Omnimino *GG) {
   unsigned int i, FW;
   struct Coord **F;
 
@@ -244,12 +436,12 @@ static int CheckFigures(void) {
 }
 
 
-static int ReadBlocks(void) {
+static int ReadBlocks(struct Omnimino *GG) {
   unsigned int i;
   struct Coord *B;
 
   for (i = 0, B = Block; B < *LastFigure; B++, i++) {
-    if ((ReadInt(&(B->x), ',') != 0) || (ReadInt(&(B->y), ';') != 0)) {
+    if ((ReadInt(GG, &(B->x), ',') != 0) || (ReadInt(GG, &(B->y), ';') != 0)) {
       snprintf(MsgBuf, OM_STRLEN, "[19] Block[%d] : load error.", i); return 1;
     }
   }
@@ -258,18 +450,37 @@ static int ReadBlocks(void) {
 }
 
 
-static int CheckBlocks(void) {
-  unsigned int i, FS;
+/*
+  Cells the blocks cover along one axis, as GetMask() counts them. The
+  blocks of a record need not all lie on cells of the same parity, then
+  Moved gets the most they may cover once Deploy() recenters the figure.
+*/
+
+static long long CellSpan(struct Coord **F, bfunc FindMin, bfunc FindMax, long long *Moved) {
+  long long Min = ForEachIn(F, FindMin, INT_MAX);
+  long long Max = ForEachIn(F, FindMax, INT_MIN);
+
+  *Moved = ((Max - Min + 1) >> 1) + 1;
+
+  return (Max >> 1) - (Min >> 1) + 1;
+}
+
+
+static int CheckBlocks(struct Omnimino *GG) {
+  static const char *Side[2] = {"width", "height"};
+  unsigned int i, j;
+  long long FS, Moved;
   struct Coord **F;
 
   for (i = 0, F = Figure; F < LastFigure; F++, i++) {
-    FS = Dimension(F, FindLeft, FindRight);
-    if (FS > FigureSize) {
-      snprintf(MsgBuf, OM_STRLEN, "[19] Figure[%d] width (%d) > FigureSize (%d)", i, FS, FigureSize); return 1;
-    }
-    FS = Dimension(F, FindBottom, FindTop);
-    if (FS > FigureSize) {
-      snprintf(MsgBuf, OM_STRLEN, "[19] Figure[%d] height (%d) > FigureSize (%d)", i, FS, FigureSize); return 1;
+    for (j = 0; j < 2; j++) {
+      FS = j ? CellSpan(F, FindBottom, FindTop, &Moved) : CellSpan(F, FindLeft, FindRight, &Moved);
+      if (FS > FigureSize) {
+        snprintf(MsgBuf, OM_STRLEN, "[19] Figure[%d] %s (%lld) > FigureSize (%d)", i, Side[j], FS, FigureSize); return 1;
+      }
+      if (Moved > MAX_FIGURE_SIZE) {
+        snprintf(MsgBuf, OM_STRLEN, "[19] Figure[%d] %s (%lld) > %d once deployed", i, Side[j], Moved, MAX_FIGURE_SIZE); return 1;
+      }
     }
   }
 
@@ -277,11 +488,11 @@ static int CheckBlocks(void) {
 }
 
 
-static int ReadData(void) {
+static int ReadData(struct Omnimino *GG) {
 
-  if (ReadPointer(&LastFigure, 0) != 0) {
+  if (ReadPointer(GG, &LastFigure, 0) != 0) {
     snprintf(MsgBuf, OM_STRLEN, "[15] LastFigure : load error.");
-  } else if (ReadPointer(&NextFigure, 0) != 0) {
+  } else if (ReadPointer(GG, &NextFigure, 0) != 0) {
     snprintf(MsgBuf, OM_STRLEN, "[16] CurFigure : load error.");
   } else {
     return 0;
@@ -291,7 +502,7 @@ static int ReadData(void) {
 }
 
 
-static int CheckData(void) {
+static int CheckData(struct Omnimino *GG) {
   int MaxFigure = TotalArea / WeightMin + 1;
 
   if ((LastFigure - Figure) > MaxFigure) {
@@ -309,25 +520,43 @@ static int CheckData(void) {
 }
 
 
-static int LoadData(void) {
+/* Player, time of save, seed and generator */
+
+static int ReadSignature(struct Omnimino *GG) {
+  ReadString(GG, PlayerName);
+
+  if (ReadInt(GG, (int *)&TimeStamp, 0) != 0) {
+    snprintf(MsgBuf, OM_STRLEN, "[21] TimeStamp read error.");
+  } else if (*LoadPtr && (ReadLong(GG, &Seed) != 0)) { /* older records have no seed */
+    snprintf(MsgBuf, OM_STRLEN, "[22] Seed read error.");
+  } else if (*LoadPtr && (ReadInt(GG, (int *)&Generator, 0) != 0)) {
+    snprintf(MsgBuf, OM_STRLEN, "[23] Generator read error.");
+  } else if (Generator > FIGURES_UNIFORM) {
+    snprintf(MsgBuf, OM_STRLEN, "[23] Generator (%d) can be 0 or 1", Generator);
+  } else {
+    return 0;
+  }
+
+  return 1;
+}
+
+
+static int LoadData(struct Omnimino *GG) {
 
-  ReadString(ParentName);
+  ReadString(GG, ParentName);
 
   if ((AllocateBuffers(GG) == 0) &&
-      (ReadData() == 0) &&
-      (ReadGlassFill() == 0) &&
-      (CheckGlassFill() == 0) &&
-      (CheckData() == 0) &&
-      (ReadFigures() == 0) &&
-      (CheckFigures() == 0) &&
-      (ReadBlocks() == 0) &&
-      (CheckBlocks() == 0)) {
-    ReadString(PlayerName); /* skip new line following block descriptions */
-    ReadString(PlayerName);
-
-    if (ReadInt((int *)&TimeStamp, 0) != 0) {
-      snprintf(MsgBuf, OM_STRLEN, "[21] TimeStamp read error.");
-    } else {
+      (ReadData(GG) == 0) &&
+      (ReadGlassFill(GG) == 0) &&
+      (CheckGlassFill(GG) == 0) &&
+      (CheckData(GG) == 0) &&
+      (ReadFigures(GG) == 0) &&
+      (CheckFigures(GG) == 0) &&
+      (ReadBlocks(GG) == 0) &&
+      (CheckBlocks(GG) == 0)) {
+    ReadString(GG, PlayerName); /* skip new line following block descriptions */
+
+    if (ReadSignature(GG) == 0) {
       GameType = 1;
 
       LastTouched = NextFigure;
@@ -340,81 +569,347 @@ static int LoadData(void) {
 }
 
 
-#include <sys/stat.h>
-#include <sys/mman.h>
+/* Lines 15..19 are skipped as SaveGame writes them, no buffers are allocated */
 
+static int LoadHeaderData(struct Omnimino *GG) {
+  unsigned int i;
 
-static int DoLoad(char *BufAddr, size_t BufLen) {
-  char BufName[OM_STRLEN + 1];
+  ReadString(GG, ParentName);
 
-  md5hash(BufAddr, BufLen, BufName);
-  strcat(BufName, ".mino");
+  for (i = 15; i <= 19; i++)
+    LoadPtr = SkipLine(LoadPtr);
 
-  LoadPtr = BufAddr;
+  if (ReadSignature(GG) != 0)
+    return 1;
+
+  GameType = 1;
+
+  return 0;
+}
+
+
+/**************************************
+
+         Binary record loading
 
-  if ((ReadParameters() != 0) || (CheckParameters() != 0))
+**************************************/
+
+
+/* Older headers end before the fields added later */
+
+static size_t BinHeaderLen(struct OmniBinHeader *H) {
+  switch (H->Version) {
+    case 1:
+      return offsetof(struct OmniBinHeader, FigureSeed);
+    case 2:
+      return offsetof(struct OmniBinHeader, FigureSource);
+    default:
+      return sizeof(struct OmniBinHeader);
+  }
+}
+
+
+static unsigned int *BinData(struct OmniBinHeader *H) {
+  return (unsigned int *) (((char *) H) + BinHeaderLen(H));
+}
+
+
+static int LoadBinaryFill(struct Omnimino *GG, struct OmniBinHeader *H) {
+  unsigned int i, *Row = BinData(H);
+
+  if (H->FillNum != FillLevel) {
+    snprintf(MsgBuf, OM_STRLEN, "[17] GlassRow number (%d) != FillLevel (%d).", H->FillNum, FillLevel); return 1;
+  }
+
+  for (i = 0; i < FillLevel * RowWords; i++)
+    FillBuf[i] = Row[i] & FullRow[i % RowWords];
+
+  return CheckGlassFill(GG);
+}
+
+
+static int LoadBinaryFigures(struct Omnimino *GG, struct OmniBinHeader *H) {
+  unsigned int i, *Offset = BinData(H) + H->FillNum * RowWords;
+  short *XY = (short *) (Offset + H->FigureNum + 1);
+  struct Coord **F, *B;
+
+  if (H->BlockNum != Offset[H->FigureNum]) {
+    snprintf(MsgBuf, OM_STRLEN, "[18] Figure[%d] (%d) != BlockNum (%d).", H->FigureNum, Offset[H->FigureNum], H->BlockNum); return 1;
+  }
+
+  if (H->BlockNum > (GlassWidth * GlassHeightBuf + MAX_FIGURE_SIZE)) {
+    snprintf(MsgBuf, OM_STRLEN, "[19] BlockNum (%d) is too large.", H->BlockNum); return 1;
+  }
+
+  for (F = Figure; F <= LastFigure; F++)
+    *F = Block + *Offset++;
+
+  if (CheckFigures(GG) != 0)
     return 1;
 
-  if (strcmp(BufName, GameName) != 0) {
-    if (FillRatio == 0) {
-      char Dummy[OM_STRLEN + 1];
+  for (i = 0, B = Block; i < H->BlockNum; i++, B++) { /* widened, the game moves them */
+    B->x = *XY++;
+    B->y = *XY++;
+  }
 
-      ReadString(Dummy);
-      ReadString(Dummy);
-      ReadString(Dummy);
+  return CheckBlocks(GG);
+}
+
+
+static int LoadBinarySignature(struct Omnimino *GG, struct OmniBinHeader *H) {
+  snprintf(PlayerName, OM_STRLEN + 1, "%.*s", OM_STRLEN, H->Player);
+  TimeStamp = H->Stamp;
+  Seed = (H->Version >= 2) ? H->FigureSeed : 0;
+  Generator = (H->Version >= 3) ? H->FigureSource : FIGURES_GROWN;
+
+  if (Generator > FIGURES_UNIFORM) {
+    snprintf(MsgBuf, OM_STRLEN, "[23] Generator (%d) can be 0 or 1", Generator); return 1;
+  }
+
+  return 0;
+}
+
+
+static int LoadBinaryData(struct Omnimino *GG, struct OmniBinHeader *H) {
+  snprintf(ParentName, OM_STRLEN + 1, "%.*s", OM_STRLEN, H->Parent);
+
+  if (AllocateBuffers(GG) != 0)
+    return 1;
+
+  LastFigure = Figure + H->FigureNum;
+  NextFigure = Figure + H->NextNum;
+
+  if ((LoadBinaryFill(GG, H) == 0) &&
+      (CheckData(GG) == 0) &&
+      (LoadBinaryFigures(GG, H) == 0) &&
+      (LoadBinarySignature(GG, H) == 0)) {
+    GameType = 1;
+
+    LastTouched = NextFigure;
 
-      if ((ReadGlassFill() != 0) || (CheckGlassFill() != 0))
-        return 1;  
-    }
-    GameType = 2;
     return 0;
   }
 
-  return LoadData();
+  return 1;
 }
 
 
-int LoadGame(struct Omnimino *G, char *Name) {
-  unsigned int i;
-  unsigned int *Par = (unsigned int *)(&(G->P));
+static int DoLoadBinary(struct Omnimino *GG, char *BufAddr, size_t BufLen, int Full) {
+  struct OmniBinHeader *H = (struct OmniBinHeader *) BufAddr;
+  char BufName[OM_STRLEN + 1];
+  size_t DataLen;
 
-  struct stat st;
+  if (BufLen < offsetof(struct OmniBinHeader, FigureSeed)) {
+    snprintf(MsgBuf, OM_STRLEN, "Binary record header is truncated."); return 1;
+  }
 
-  GG = G;
+  if ((__builtin_bswap32(H->Version) >= 1) && (__builtin_bswap32(H->Version) <= BIN_VERSION)) {
+    snprintf(MsgBuf, OM_STRLEN, "Binary record is in foreign byte order."); return 1;
+  }
 
-  snprintf(GameName, OM_STRLEN, "%s", basename(Name));
+  if ((H->Version < 1) || (H->Version > BIN_VERSION)) {
+    snprintf(MsgBuf, OM_STRLEN, "Binary record version %d is not supported.", H->Version); return 1;
+  }
 
-  for (i = 0; i < PARNUM; i++)
-    Par[i] = -1;
+  if (BufLen < BinHeaderLen(H)) {
+    snprintf(MsgBuf, OM_STRLEN, "Binary record header is truncated."); return 1;
+  }
+
+  md5hash(BufAddr + BIN_HASHED_PART, BufLen - BIN_HASHED_PART, BufName);
+
+  if (memcmp(BufName, H->Hash, MD5HASH_LEN) != 0) {
+    snprintf(MsgBuf, OM_STRLEN, "Binary record hash mismatch."); return 1;
+  }
+
+  memcpy(&(GG->P), H->Parms, sizeof(struct OmniParms));
+
+  if (CheckParameters(GG) != 0) /* RowWords are needed for the size */
+    return 1;
+
+  DataLen = BinHeaderLen(H) +
+            (H->FillNum * RowWords + (H->FigureNum ? (H->FigureNum + 1) : 0) + H->BlockNum) * sizeof(int);
+
+  if ((H->FillNum > MAX_GLASS_HEIGHT) || (H->FigureNum > (MAX_GLASS_HEIGHT * MAX_GLASS_WIDTH)) ||
+      (H->BlockNum > (MAX_GLASS_HEIGHT * MAX_GLASS_WIDTH + MAX_FIGURE_SIZE)) || (DataLen != BufLen)) {
+    snprintf(MsgBuf, OM_STRLEN, "Binary record size mismatch."); return 1;
+  }
+
+  strcat(BufName, ".mino");
+
+  if (strcmp(BufName, GameName) != 0) {
+    if (Full && (FillRatio == 0) && (LoadBinaryFill(GG, H) != 0))
+      return 1;
+    GameType = 2;
+    return 0;
+  }
+
+  if (!Full) {
+    snprintf(ParentName, OM_STRLEN + 1, "%.*s", OM_STRLEN, H->Parent);
+    if (LoadBinarySignature(GG, H) != 0)
+      return 1;
+    GameType = 1;
+    return 0;
+  }
+
+  return LoadBinaryData(GG, H);
+}
+
+
+/**************************************
+
+              DoLoad
 
+**************************************/
+
+static void ForgetData(struct Omnimino *GG) {
   MsgBuf[0] = '\0';
   PlayerName[0] = '\0';
   TimeStamp = 0;
+  Seed = 0;
+  Generator = FIGURES_GROWN;
   GameType = 3;
-  GameModified=0;
   LastFigure = Figure; /* mark missing game data */
   strcpy(ParentName, "none");
+}
 
-  if (stat(Name, &st) < 0) {
-    snprintf(MsgBuf, OM_STRLEN, "Can not stat file %s.", Name);
-  } else {
-    int fd = open(Name, O_RDONLY);
-    if (fd < 0) {
-      snprintf(MsgBuf, OM_STRLEN, "Can not open for read %s.", Name);
-    } else {
-      char *Buf = mmap(NULL, st.st_size + 1, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
-      close(fd);
-      if (Buf == MAP_FAILED) {
-        snprintf(MsgBuf, OM_STRLEN, "mmap failed.");
-      } else {
-        Buf[st.st_size] = '\0';
-        int Err = DoLoad(Buf, st.st_size);
-        munmap(Buf, st.st_size + 1);
-        return Err;
-      }
+
+static int DoLoad(struct Omnimino *GG, char *BufAddr, size_t BufLen, int Full) {
+  char BufName[OM_STRLEN + 1];
+  char *Body;
+  unsigned int Area;
+  int Err = 0;
+
+  RecordFormat = FORMAT_TEXT;
+  if ((BufLen >= 4) && (memcmp(BufAddr, BIN_MAGIC, 4) == 0)) {
+    RecordFormat = FORMAT_BINARY;
+    return DoLoadBinary(GG, BufAddr, BufLen, Full);
+  }
+
+  LoadPtr = BufAddr;
+  LoadEnd = BufAddr + BufLen;
+  HashedPtr = BufAddr;
+
+  if (IsHashName(GameName)) {
+    struct md5 Hash;
+
+    md5hash_init(&Hash);
+    LoadHash = &Hash;
+
+    if ((ReadParameters(GG) != 0) || (CheckParameters(GG) != 0)) {
+      LoadHash = NULL;
+      return 1;
     }
+
+    Body = LoadPtr;
+    Area = TotalArea;
+
+    Err = Full ? LoadData(GG) : LoadHeaderData(GG);
+
+    HashRest(GG, BufName);
+    strcat(BufName, ".mino");
+
+    if (strcmp(BufName, GameName) == 0)
+      return Err;
+
+    ForgetData(GG); /* not its hash, a preset as any other name */
+    TotalArea = Area;
+    LoadPtr = Body;
+  } else {
+    LoadHash = NULL;
+
+    if ((ReadParameters(GG) != 0) || (CheckParameters(GG) != 0))
+      return 1;
+  }
+
+  if (Full && (FillRatio == 0)) {
+    char Dummy[OM_STRLEN + 1];
+
+    ReadString(GG, Dummy);
+    ReadString(GG, Dummy);
+    ReadString(GG, Dummy);
+
+    if ((ReadGlassFill(GG) != 0) || (CheckGlassFill(GG) != 0))
+      return 1;  
+  }
+  GameType = 2;
+
+  return 0;
+}
+
+
+/* Full 0 - glass fill, figures and blocks are skipped, the record hash is checked still */
+
+int LoadBuffer(struct Omnimino *GG, struct RecordFile *F, int Full) {
+  unsigned int i;
+  unsigned int *Par = (unsigned int *)(&(GG->P));
+
+  snprintf(GameName, OM_STRLEN, "%s", basename(F->Name));
+
+  for (i = 0; i < PARNUM; i++)
+    Par[i] = -1;
+
+  ForgetData(GG);
+  GameModified=0;
+
+  switch (F->Failure) {
+    case READ_OK:
+      return DoLoad(GG, F->Buf, F->Len, Full);
+    case READ_NO_STAT:
+      snprintf(MsgBuf, OM_STRLEN, "Can not stat file %s.", F->Name);
+      break;
+    case READ_NO_OPEN:
+      snprintf(MsgBuf, OM_STRLEN, "Can not open for read %s.", F->Name);
+      break;
+    case READ_NO_READ:
+      snprintf(MsgBuf, OM_STRLEN, "Can not read file %s.", F->Name);
+      break;
+    default:
+      snprintf(MsgBuf, OM_STRLEN, "Out of memory reading %s.", F->Name);
+      break;
   }
 
   return 1;
 }
 
+
+/* Mapped where the zeroes past its end in the last page hold RECORD_PAD, read otherwise */
+
+static int OpenRecord(struct Omnimino *GG, char *Name, int Full) {
+  struct RecordFile F;
+  struct stat st;
+  long Page = sysconf(_SC_PAGESIZE);
+  int Err, fd;
+
+  memset(&F, 0, sizeof(F));
+  F.Name = Name;
+
+  if ((stat(Name, &st) == 0) && S_ISREG(st.st_mode) && (st.st_size % Page != 0) &&
+      (Page - st.st_size % Page >= RECORD_PAD) && ((fd = open(Name, O_RDONLY | O_CLOEXEC)) >= 0)) {
+    F.Buf = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (F.Buf != MAP_FAILED) {
+      F.Len = st.st_size;
+      F.Failure = READ_OK;
+      Err = LoadBuffer(GG, &F, Full);
+      munmap(F.Buf, st.st_size);
+      return Err;
+    }
+    F.Buf = NULL;
+  }
+
+  ReadRecord(&F);
+  Err = LoadBuffer(GG, &F, Full);
+  FreeRecord(&F);
+
+  return Err;
+}
+
+
+int LoadGame(struct Omnimino *GG, char *Name) {
+  return OpenRecord(GG, Name, 1);
+}
+
+
+int LoadHeader(struct Omnimino *GG, char *Name) {
+  return OpenRecord(GG, Name, 0);
+}
@@ -3,8 +3,12 @@
 #define _OMNILOAD_H 1
 
 #include "omnitype.h"
+#include "omniread.h"
 
+int CheckParameters(struct Omnimino *G);
 int LoadGame(struct Omnimino *G, char *Name);
+int LoadHeader(struct Omnimino *G, char *Name); /* no glass fill, figures and blocks */
+int LoadBuffer(struct Omnimino *G, struct RecordFile *F, int Full);
 
 #endif
 
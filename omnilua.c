@@ -10,7 +10,7 @@ void ExportLua(struct Omnimino *GG, FILE *fout) {
   unsigned int i, Order[] = {2,7,0,1,4,5,6,8,9,10,11,12,3};
   unsigned int *Par = (unsigned int *)(&(GG->P));
   char *sfmt = "[[%s]], ";
-  char *MsgFmt = (GameType == 1) ? "%s, " : sfmt;
+  char *MsgFmt = (GameType == 1) ? (MsgBuf[0] ? "%s, " : "nil, ") : sfmt; /* the score of a game, nil if not replayed */
   char *ParentExported = ParentName;
 
 
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <time.h>
 
@@ -9,13 +10,17 @@
 
 int AllocateBuffers(struct Omnimino *GG) {
 
-  /* Figure, Block, GlassRow = StoreBuf */
+  /* Figure, QueueStart, QueueBlock, Block, Checkpoint, GlassBuf = StoreBuf */
 
   unsigned int MaxFigure = TotalArea / WeightMin + 4;
   unsigned int MaxBlock = TotalArea + 2 * MAX_FIGURE_SIZE;
+  unsigned int MaxCheckpoint = MaxFigure / CHECKPOINT_STEP + 1;
 
   size_t FigureBufSize = MaxFigure * sizeof(struct Coord *); 
+  size_t QueueBufSize = MaxFigure * sizeof(unsigned int) + MaxBlock * sizeof(struct Coord);
   size_t BlockBufSize  = MaxBlock * sizeof(struct Coord);
+  size_t CheckpointLen = (GlassHeightBuf + FigureSize + 1) * RowWords + 3;
+  size_t CheckpointBufSize = MaxCheckpoint * CheckpointLen * sizeof(unsigned int);
 
 /*
   Sizes of the parameters and data text representations
@@ -24,17 +29,19 @@ int AllocateBuffers(struct Omnimino *GG) {
   ParentName: OM_STRLEN+1 = 81
   FigureNum:  10+1 = 11
   CurFigure:  10+1 = 11
-  FillBuf:    FillLevel * (10+1) = FillLevel * 11
+  FillBuf:    FillLevel * RowWords * (10+1) = FillLevel * RowWords * 11
   BlockN:     (FigureNum+2) * (10+1) = MaxFigure * 11
   Block:      MaxBlock * (2+1,4+1) = MaxBlock * 8
   PlayerName: OM_STRLEN+1 = 81
   TimeStamp:  10+1 = 11
+  Seed:       20+1 = 21
+  Generator:  10+1 = 11
 */
 
-  StoreBufSize = 62 + 81 + 11 + 11 + FillLevel * 11 +
-                 MaxFigure * 11 + MaxBlock * 11 + 81 + 11;
+  StoreBufSize = 62 + 81 + 11 + 11 + FillLevel * RowWords * 11 +
+                 MaxFigure * 11 + MaxBlock * 11 + 81 + 11 + 21 + 11;
 
-  size_t NewGameBufSize = FigureBufSize + BlockBufSize + StoreBufSize;
+  size_t NewGameBufSize = FigureBufSize + QueueBufSize + BlockBufSize + CheckpointBufSize + 7 + StoreBufSize;
 
   if (GameBufSize == 0) {
     Figure = malloc(NewGameBufSize);
@@ -55,8 +62,16 @@ int AllocateBuffers(struct Omnimino *GG) {
     }
   }
 
-  Block = (struct Coord *) (Figure + MaxFigure);
-  GlassRow = (unsigned int *) (Block + MaxBlock);
+  QueueStart = (unsigned int *) (Figure + MaxFigure);
+  QueueBlock = (struct Coord *) (QueueStart + MaxFigure);
+  Block = QueueBlock + MaxBlock; /* above QueueBlock, see CopyFigure() */
+  Checkpoint = (unsigned int *) (Block + MaxBlock);
+  /* 8 byte aligned for the 64 bit fields of struct OmniBinHeader */
+  GlassBuf = (unsigned int *) (((uintptr_t) (Checkpoint + MaxCheckpoint * CheckpointLen) + 7) & ~(uintptr_t) 7);
+  GlassRow = GlassBuf;
+
+  CheckpointNum = 0;
+  QueueLen = 0;
 
   return 0;
 }
@@ -29,44 +29,37 @@
 
 #include <stdio.h>
 #include <unistd.h>
+#include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 
 #include "omnigame.h"
 #include "omniload.h"
 #include "omnisave.h"
-#include "omnilua.h"
 #include "omninew.h"
-
-#define stringize(s) stringyze(s)
-#define stringyze(s) #s
-
-
-void Report(struct Omnimino *G) {
-  if ((G->V.GameType != 3) && (G->D.LastFigure != G->M.Figure)) { /* game data present */
-    int Score = G->V.EmptyCells;
-    if (G->P.Goal != FILL_GOAL) {
-      Score = G->C.TotalArea;
-      if (G->V.GoalReached)
-        Score -= G->V.EmptyCells;
-    }
-    snprintf(G->S.MsgBuf, OM_STRLEN,  "%d", Score);
-  }
-
-  if (isatty(fileno(stdout))) {
-    fprintf(stdout, "%s\n", G->S.MsgBuf);
-  } else {
-    ExportLua(G, stdout);
-  }
-}
-
+#include "omnirow.h"
+#include "omnibatch.h"
+#include "omniplay.h"
+#include "omnisolve.h"
+#include "omnigen.h"
 
 #define COPYRIGHT "Omnimino 0.6.3 Copyright (C) 2019-2024 Andrey Dobrovolsky\n\n"
-#define USAGE "Usage: omnimino infile\n       ls *.mino | omnimino > outfile\n\n"
+#define USAGE "Usage: omnimino [-r seed] [-u] infile\n       omnimino -p [-r seed] [-u] infile < commands\n       omnimino -b|-t infile ...\n       omnimino -s [-r seed] [-u] [-w width] [-j jobs] infile ...\n       omnimino -g count [-r seed] [-u] [-j jobs] preset\n       omnimino -v [-j jobs] infile ...|-d dir ...\n       ls *.mino | omnimino [-l] [-j jobs] [-c cachefile] > outfile\n       omnimino [-l] [-j jobs] [-c cachefile] -d dir ... > outfile\n\n"
 
 
 int main(int argc,char *argv[]){
-  int argi;
-  char FName[OM_STRLEN + 1];
+  int argi, Opt, Format = -1, Protocol = 0, Solve = 0, Verify = 0, Scores = 1;
+  unsigned int Jobs = 1, Beam = 64;
+  unsigned long long Seed = 0; /* of the figures for presets, 0 - a fresh one */
+  unsigned int Generator = FIGURES_GROWN;
+  unsigned long Count = 0;
+  char *JobsArg = NULL;
+  char *End;
+  char *CacheName = NULL;
+  char **Dir = NULL;
+  unsigned int DirNum = 0;
+  struct NameList Names;
+  struct NameList *List = NULL;
 
   char *PName = basename(argv[0]);
 
@@ -78,30 +71,147 @@ int main(int argc,char *argv[]){
 
   if (strcmp(PName, "omnimino") == 0) {
 
-    if (argc > 1) {
-      for (argi = 1; argi < argc; argi++){
+    while ((Opt = getopt(argc, argv, "j:c:d:btpsw:r:ug:vl")) != -1) {
+      switch (Opt) {
+        case 'j':
+          JobsArg = optarg;
+          break;
+        case 'c':
+          CacheName = optarg;
+          break;
+        case 'd':
+          if ((Dir == NULL) && ((Dir = calloc(argc, sizeof(char *))) == NULL))
+            return 1;
+          Dir[DirNum++] = optarg;
+          break;
+        case 'b':
+          Format = FORMAT_BINARY;
+          break;
+        case 't':
+          Format = FORMAT_TEXT;
+          break;
+        case 'p':
+          Protocol = 1;
+          break;
+        case 's':
+          Solve = 1;
+          break;
+        case 'w':
+          Beam = strtoul(optarg, NULL, 10);
+          break;
+        case 'r':
+          errno = 0;
+          Seed = strtoull(optarg, &End, 10);
+          if ((Seed == 0) || (optarg[0] < '0') || (optarg[0] > '9') || *End || errno) { /* 0 is kept in the records for no seed */
+            fprintf(stderr, "Seed must be a number 1 .. %llu.\n", ~0ULL);
+            return 1;
+          }
+          break;
+        case 'u':
+          Generator = FIGURES_UNIFORM;
+          break;
+        case 'g':
+          Count = strtoul(optarg, NULL, 10);
+          break;
+        case 'v':
+          Verify = 1;
+          break;
+        case 'l':
+          Scores = 0;
+          break;
+        default:
+          fprintf(stdout, COPYRIGHT USAGE);
+          return 1;
+      }
+    }
+
+    if (JobsArg)
+      Jobs = strtoul(JobsArg, NULL, 10);
+    else if (Solve || Count || Verify)
+      Jobs = 0; /* solver, generator and verification use all CPUs by default */
+
+    if (Seed && Count && (Seed + (Count - 1) < Seed)) {
+      fprintf(stderr, "Seed %llu leaves no room for %lu games.\n", Seed, Count);
+      return 1;
+    }
+
+    if (Count && (optind < argc)) {
+      return GenerateGames(argv[optind], Count, Seed, Generator, Jobs, stdout);
+    } else if (Solve && (optind < argc)) {
+      for (argi = optind; argi < argc; argi++){
         if (LoadGame(&Game, argv[argi]) == 0) {
-          if ((Game.V.GameType == 1) || (NewGame(&Game) == 0)) {
+          if ((Game.V.GameType == 1) || (NewGame(&Game, Seed, Generator) == 0)) {
+            if (SolveGame(&Game, Beam, Jobs) == 0) {
+              EndGame(&Game);
+              SaveGame(&Game);
+              if (Game.V.GameType != 3)
+                snprintf(Game.S.MsgBuf, OM_STRLEN, "%d %s", GetScore(&Game), Game.S.GameName);
+            }
+          }
+        }
+        fprintf(stdout, "%s %s\n", argv[argi], Game.S.MsgBuf);
+      }
+    } else if (Verify && (DirNum > 0)) {
+      char **Path;
+
+      ScanDirs(&Names, Dir, DirNum);
+      if ((Path = ScannedPaths(&Names)) != NULL)
+        VerifyFiles(Path, Names.Num, Jobs, stdout);
+      free(Path);
+      FreeNames(&Names);
+      free(Dir);
+    } else if (Verify && (optind < argc)) {
+      VerifyFiles(argv + optind, argc - optind, Jobs, stdout);
+    } else if (Protocol && (optind < argc)) {
+      if (LoadGame(&Game, argv[optind]) == 0) {
+        if ((Game.V.GameType == 1) || (NewGame(&Game, Seed, Generator) == 0))
+          PlayProtocol(&Game, fileno(stdin), stdout);
+      }
+      if (Game.V.GameType == 3) {
+        fprintf(stdout, "error %s\n", Game.S.MsgBuf);
+        return 1;
+      }
+    } else if ((Format >= 0) && (optind < argc)) {
+      for (argi = optind; argi < argc; argi++){
+        if (LoadGame(&Game, argv[argi]) == 0)
+          ExportGame(&Game, Format);
+        fprintf(stdout, "%s\n", (Game.V.GameType == 3) ? Game.S.MsgBuf : Game.S.GameName);
+      }
+    } else if (optind < argc) {
+      for (argi = optind; argi < argc; argi++){
+        if (LoadGame(&Game, argv[argi]) == 0) {
+          if ((Game.V.GameType == 1) || (NewGame(&Game, Seed, Generator) == 0)) {
             if (PlayGame(&Game))
               SaveGame(&Game);
           }
         }
-        Report(&Game);
+        Report(&Game, stdout);
       }
     } else {
-      if (isatty(fileno(stdin))) {
+      if (DirNum > 0) {
+        ScanDirs(&Names, Dir, DirNum);
+        List = &Names;
+      }
+
+      if ((List == NULL) && isatty(fileno(stdin))) {
         fprintf(stdout, COPYRIGHT USAGE);
-      } else {
-        while (fscanf(stdin, "%" stringize(OM_STRLEN) "s%*[^\n]", FName) > 0) {
-          if (LoadGame(&Game, FName) == 0) {
-            if (Game.V.GameType == 1) {
-              Game.V.CurFigure = Game.D.NextFigure + 1;
-              GetGlassState(&Game);
-            }
-          }
-          Report(&Game);
+      } else if (CacheName) {
+        struct OmniCache Cache;
+
+        if (LoadCache(&Cache, CacheName) != 0) {
+          BatchReport(stdin, List, Jobs, NULL, Scores);
+        } else {
+          BatchReport(stdin, List, Jobs, &Cache, Scores);
+          if (SaveCache(&Cache, CacheName) != 0)
+            fprintf(stderr, "Can not write cache %s.\n", CacheName);
         }
+      } else {
+        BatchReport(stdin, List, Jobs, NULL, Scores);
       }
+
+      if (List)
+        FreeNames(List);
+      free(Dir);
       fprintf(stdout, "MaxFigureSize = %d, MaxGlassWidth = %d, MaxGlassHeight = %d\n\n",
                        MAX_FIGURE_SIZE,    MAX_GLASS_WIDTH,    MAX_GLASS_HEIGHT);
     }
@@ -129,13 +239,14 @@ int main(int argc,char *argv[]){
 
         Game.C.TotalArea = Game.P.GlassWidth * Game.P.GlassHeightBuf;
 
-        if (NewGame(&Game) == 0) {
+        if (NewGame(&Game, 0, FIGURES_GROWN) == 0) {
           if (PlayGame(&Game)) {
             Game.P = PBuf;
             Game.P.FillLevel = Game.P.GlassHeightBuf;
-            while ((Game.P.FillLevel > 0) && (Game.M.GlassRow[Game.P.FillLevel - 1] == 0))
+            while ((Game.P.FillLevel > 0) &&
+                   (RowCount(Game.M.GlassRow + (Game.P.FillLevel - 1) * Game.C.RowWords, Game.C.RowWords) == 0))
               Game.P.FillLevel--;
-            memcpy(Game.M.FillBuf, Game.M.GlassRow, Game.P.FillLevel * sizeof(int));
+            memcpy(Game.M.FillBuf, Game.M.GlassRow, Game.P.FillLevel * Game.C.RowWords * sizeof(int));
             Game.P.FillRatio = 0;
             Game.V.GameType = 2;
             SaveGame(&Game);
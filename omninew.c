@@ -2,11 +2,12 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
 
 #include "omnifunc.h"
 #include "omnimem.h"
-
-static struct Omnimino *GG;
+#include "omnirow.h"
+#include "omnishape.h"
 
 #include "omnimino.def"
 
@@ -16,22 +17,92 @@ void InitGame(struct Omnimino *G) {
 }
 
 
+/**************************************
+
+         Figures' random source
+
+  xoshiro256** per game, its state is
+  expanded from the 64 bit Seed with
+  splitmix64, so any game can be made
+  again from Seed on any host.
+
+**************************************/
+
+static unsigned long long SplitMix(unsigned long long *S) {
+  unsigned long long z = (*S += 0x9e3779b97f4a7c15ULL);
+
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+
+  return z ^ (z >> 31);
+}
+
+
+static unsigned long long Rotl(unsigned long long x, int k) {
+  return (x << k) | (x >> (64 - k));
+}
+
+
+static unsigned long long NextRandom(struct Omnimino *GG) {
+  unsigned long long *s = RandomState;
+  unsigned long long r = Rotl(s[1] * 5, 7) * 9;
+  unsigned long long t = s[1] << 17;
+
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = Rotl(s[3], 45);
+
+  return r;
+}
+
+
+/* 0 .. n-1 */
+
+static unsigned int Random(struct Omnimino *GG, unsigned int n) {
+  return (unsigned int) (((NextRandom(GG) >> 32) * n) >> 32);
+}
+
+
+/* Distinct for games started in the same second by other processes or threads */
+
+static unsigned long long FreshSeed(void) {
+  static unsigned long long Counter;
+  unsigned long long S = ((unsigned long long) time(NULL) << 20) ^ ((unsigned long long) getpid() << 40) ^
+                         __atomic_fetch_add(&Counter, 1, __ATOMIC_RELAXED);
+
+  return SplitMix(&S) | 1;
+}
+
+
+static void SeedRandom(struct Omnimino *GG, unsigned long long NewSeed) {
+  unsigned long long S = NewSeed;
+  int i;
+
+  Seed = NewSeed;
+
+  for (i = 0; i < 4; i++)
+    RandomState[i] = SplitMix(&S);
+}
+
+
 /**************************************
 
            New game functions
 
 **************************************/
 
-static void FillGlass(void){
-  unsigned int i, Places, Blocks;
+static void FillGlass(struct Omnimino *GG){
+  unsigned int i, Places, Blocks, *R;
 
   if (FillRatio != 0) {
-    for (i = 0 ; i < FillLevel ; i++) {
-      FillBuf[i] = 0;
+    for (i = 0, R = FillBuf ; i < FillLevel ; i++, R += RowWords) {
+      memset(R, 0, RowWords * sizeof(int));
       for (Places = GlassWidth, Blocks = FillRatio ; Places > 0 ; Places--) {
-        FillBuf[i] <<= 1;
-        if ((rand() % Places) < Blocks) {
-          FillBuf[i] |= 1; Blocks--;
+        if (Random(GG, Places) < Blocks) {
+          SetRowBit(R, Places - 1); Blocks--;
         }
       }
     }
@@ -40,7 +111,7 @@ static void FillGlass(void){
 }
 
 
-static int SelectSlots(struct Coord *Slot, struct Coord *FBlock, int Weight) {
+static int SelectSlots(struct Omnimino *GG, struct Coord *Slot, struct Coord *FBlock, int Weight) {
   int SlotNum = 0, SeedCnt, x, y;
   int UseNeighbours = ((Aperture == 0) && Weight);
   int ApertureSize = ((Aperture == 0) ? (Weight ? 3 : 1) : Aperture);
@@ -72,12 +143,12 @@ static int SelectSlots(struct Coord *Slot, struct Coord *FBlock, int Weight) {
 #define MAX_SLOTS MAX_SLOTS_COMPACT
 #endif
 
-static int NewFigure(struct Coord *F) {
+static int NewFigure(struct Omnimino *GG, struct Coord *F) {
   unsigned int i;
   struct Coord Slot[MAX_SLOTS], *B;
   
   for (i = 0, B = F; i < WeightMax; i++){
-    memcpy(B, Slot + (rand() % SelectSlots(Slot, F, B-F)),sizeof(struct Coord));
+    memcpy(B, Slot + Random(GG, SelectSlots(GG, Slot, F, B-F)),sizeof(struct Coord));
     if (!FindBlock(B, F, B-F))
       B++;
   }
@@ -85,25 +156,98 @@ static int NewFigure(struct Coord *F) {
 }
 
 
+/**************************************
+
+        Uniform figures sampling
+
+  The weight is uniform in WeightMin..
+  WeightMax, then each figure of that
+  weight is equally likely: one of the
+  listed connected figures, or any set
+  of cells inside the Aperture.
+
+**************************************/
+
+struct Catalogue {
+  const struct ShapeList *Shapes[MAX_FIGURE_SIZE + 1];
+  struct Coord Slot[MAX_SLOTS];   /* the Aperture cells */
+  unsigned int SlotNum;
+  unsigned int WeightTop;
+};
+
+
+static int OpenCatalogue(struct Omnimino *GG, struct Catalogue *C) {
+  unsigned int w;
+
+  C->WeightTop = WeightMax;
+
+  if (Aperture != 0) {
+    C->SlotNum = SelectSlots(GG, C->Slot, NULL, 0);
+    if (C->WeightTop > C->SlotNum)
+      C->WeightTop = C->SlotNum;
+    return 0;
+  }
+
+  for (w = WeightMin; w <= WeightMax; w++) {
+    C->Shapes[w] = GetShapes(Metric, w);
+    if (C->Shapes[w] == NULL) {
+      snprintf(MsgBuf, OM_STRLEN, "Failed to list figures of weight %d.", w);
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+
+static int CatalogueFigure(struct Omnimino *GG, struct Catalogue *C, struct Coord *F) {
+  unsigned int Weight = WeightMin + Random(GG, C->WeightTop - WeightMin + 1);
+  unsigned long long Taken = 0;
+  unsigned int i, t;
+
+  if (Aperture == 0) {
+    ShapeFigure(C->Shapes[Weight], Weight, Random(GG, C->Shapes[Weight]->Num), F);
+  } else {
+    for (i = C->SlotNum - Weight; i < C->SlotNum; i++) { /* Floyd's sampling */
+      t = Random(GG, i + 1);
+      if ((Taken >> t) & 1)
+        t = i;
+      Taken |= 1ULL << t;
+      *F++ = C->Slot[t];
+    }
+  }
+
+  return Weight;
+}
+
+
 /**************************************
 
              NewGame
 
+  NewSeed 0 - a fresh one.
+
 **************************************/
 
-int NewGame(struct Omnimino *G){
+int NewGame(struct Omnimino *GG, unsigned long long NewSeed, unsigned int NewGenerator){
+  struct Catalogue C;
 
-  GG = G;
+  if (AllocateBuffers(GG) != 0)
+    return 1;
 
-  if (AllocateBuffers(G) != 0)
+  Generator = NewGenerator;
+  if ((Generator == FIGURES_UNIFORM) && (OpenCatalogue(GG, &C) != 0))
     return 1;
 
-  srand((unsigned int)time(NULL));
+  SeedRandom(GG, NewSeed ? NewSeed : FreshSeed());
 
-  FillGlass();
+  FillGlass(GG);
 
   for (LastFigure = Figure, Figure[0] = Block; ((*LastFigure) - Figure[0]) < (int)TotalArea; LastFigure++){
-    LastFigure[1] = (*LastFigure) + NewFigure(*LastFigure);
+    if (Generator == FIGURES_UNIFORM)
+      LastFigure[1] = (*LastFigure) + CatalogueFigure(GG, &C, *LastFigure);
+    else
+      LastFigure[1] = (*LastFigure) + NewFigure(GG, *LastFigure);
     ForEachIn(LastFigure, ScaleUp, 0);
   }
 
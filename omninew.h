@@ -5,7 +5,7 @@
 #include "omnitype.h"
 
 void InitGame(struct Omnimino *G);
-int NewGame(struct Omnimino *G);
+int NewGame(struct Omnimino *G, unsigned long long Seed, unsigned int Generator);
 
 #endif
 
@@ -0,0 +1,210 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "omnigame.h"
+#include "omnisave.h"
+#include "omniplay.h"
+
+
+/**************************************
+
+        Headless play protocol
+
+  One command per line, optionally
+  followed by repeat count. Every
+  input chunk is applied as a batch,
+  then the replies are flushed.
+
+**************************************/
+
+#define PROTO_BUF_SIZE 65536
+
+static struct ProtoCmd {
+  char *Name;
+  int Key;
+} ProtoList[] = {
+  {"left",   'h'},
+  {"right",  'l'},
+  {"up",     'k'},
+  {"down",   'j'},
+  {"ccw",    'a'},
+  {"cw",     'f'},
+  {"mirror", 's'},
+  {"drop",   ' '},
+  {"undo",   'u'},
+  {"redo",   'r'},
+  {"rewind", '^'},
+  {"last",   '$'},
+  {"skip",   'n'},
+  {"back",   'N'},
+  {"exit",   'x'},
+  {"quit",   'q'},
+
+  {NULL, 0}
+};
+
+
+static void PutState(struct Omnimino *G, FILE *fout) {
+  char *State = G->V.GoalReached ? "goal" : (G->V.GameOver ? "over" : "play");
+
+  fprintf(fout, "ok %d %d %s\n", (int)(G->V.CurFigure - G->M.Figure), GetScore(G), State);
+}
+
+
+static void PutGlass(struct Omnimino *G, FILE *fout) {
+  unsigned int i, j, *R;
+  struct Coord *B;
+
+  fprintf(fout, "glass %u %u %u", G->P.GlassWidth, G->V.GlassHeight, G->V.GlassLevel);
+  for (i = 0; i < G->V.GlassLevel; i++) { /* wide rows as one number */
+    R = G->M.GlassRow + i * G->C.RowWords;
+    for (j = G->C.RowWords - 1; (j > 0) && (R[j] == 0); j--);
+    fprintf(fout, " %x", R[j]);
+    while (j-- > 0)
+      fprintf(fout, "%08x", R[j]);
+  }
+  fprintf(fout, "\n");
+
+  fprintf(fout, "figure %d", (int)(G->V.CurFigure - G->M.Figure));
+  if (!G->V.GameOver) {
+    for (B = G->V.CurFigure[0]; B < G->V.CurFigure[1]; B++)
+      fprintf(fout, " %d,%d", B->x >> 1, B->y >> 1);
+  }
+  fprintf(fout, "\n");
+}
+
+
+static void Save(struct Omnimino *G, FILE *fout) {
+  if (!EndGame(G)) {
+    fprintf(fout, "unchanged %s\n", G->S.GameName);
+    return;
+  }
+
+  SaveGame(G);
+
+  G->V.CurFigure = G->D.NextFigure + 1; /* the record was stored over the glass */
+  GetGlassState(G);
+
+  if (G->V.GameType == 3)
+    fprintf(fout, "error %s\n", G->S.MsgBuf);
+  else
+    fprintf(fout, "saved %s\n", G->S.GameName);
+}
+
+
+/* Returns 0 when the session is over */
+
+static int ExecuteLine(struct Omnimino *G, char *Line, FILE *fout) {
+  char Name[16];
+  int Count = 1, Key;
+  struct ProtoCmd *P;
+
+  if (sscanf(Line, "%15s %d", Name, &Count) < 1)
+    return 1; /* empty line */
+
+  if (strcmp(Name, "state") == 0) {
+    PutState(G, fout);
+    return 1;
+  }
+
+  if (strcmp(Name, "glass") == 0) {
+    PutGlass(G, fout);
+    return 1;
+  }
+
+  if (strcmp(Name, "save") == 0) {
+    Save(G, fout);
+    return 1;
+  }
+
+  for (P = ProtoList; (P->Name != NULL) && (strcmp(Name, P->Name) != 0); P++);
+
+  if (P->Name != NULL)
+    Key = P->Key;
+  else if (Name[1] == '\0')
+    Key = Name[0]; /* plain game key */
+  else
+    Key = 0;
+
+  G->V.KeepPlaying = 1;
+
+  for (; Count > 0; Count--) {
+    if (!ExecuteKey(G, Key)) {
+      fprintf(fout, "error unknown command %s\n", Name);
+      return 1;
+    }
+    GetGlassState(G);
+    if (!G->V.KeepPlaying)
+      break;
+  }
+
+  if (!G->V.KeepPlaying) {
+    if (G->V.GameModified)
+      Save(G, fout);
+    else
+      fprintf(fout, "bye\n");
+    return 0;
+  }
+
+  PutState(G, fout);
+
+  return 1;
+}
+
+
+void PlayProtocol(struct Omnimino *G, int fdin, FILE *fout) {
+  char *Buf, *Line, *End;
+  size_t Len = 0;
+  ssize_t Got;
+  int Playing = 1;
+  int Overlong = 0;            /* the rest of a dropped line is to be skipped */
+
+  Buf = malloc(PROTO_BUF_SIZE + 1);
+  if (Buf == NULL) {
+    fprintf(fout, "error Failed to allocate protocol buffer.\n");
+    return;
+  }
+
+  G->V.CurFigure = G->D.NextFigure + 1; /* forces RewindGlassState() */
+  GetGlassState(G);
+  PutState(G, fout);
+  fflush(fout);
+
+  while (Playing) {
+    Got = read(fdin, Buf + Len, PROTO_BUF_SIZE - Len);
+    if (Got <= 0) {
+      if (Len == 0)
+        break;
+      Buf[Len++] = '\n'; /* last line without newline */
+    } else {
+      Len += Got;
+    }
+
+    for (Line = Buf; Playing && ((End = memchr(Line, '\n', Buf + Len - Line)) != NULL); Line = End + 1) {
+      *End = '\0';
+      if (Overlong)
+        Overlong = 0;
+      else
+        Playing = ExecuteLine(G, Line, fout);
+    }
+
+    Len -= Line - Buf;
+    if (Len == PROTO_BUF_SIZE) { /* line does not fit, drop it up to its newline */
+      if (!Overlong)
+        fprintf(fout, "error line too long\n");
+      Overlong = 1;
+      Len = 0;
+    }
+    memmove(Buf, Line, Len);
+
+    fflush(fout);
+
+    if (Got <= 0)
+      break;
+  }
+
+  free(Buf);
+}
+
@@ -0,0 +1,12 @@
+#ifndef _OMNIPLAY_H
+
+#define _OMNIPLAY_H 1
+
+#include <stdio.h>
+
+#include "omnitype.h"
+
+void PlayProtocol(struct Omnimino *G, int fdin, FILE *fout);
+
+#endif
+
@@ -0,0 +1,555 @@
+#define _GNU_SOURCE 1
+
+#include <features.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "omniread.h"
+
+/**************************************
+
+            Reading records
+
+  A record is read in whole into its
+  own buffer, which is kept and grown
+  for the next one, and RECORD_PAD zero
+  bytes end it, as the parser wants.
+  The failure of stat is told apart
+  from the failure of open for the
+  messages.
+
+**************************************/
+
+static int GrowBuffer(struct RecordFile *F, size_t Size) {
+  char *Buf;
+  size_t Max;
+
+  if (Size + RECORD_PAD <= F->BufMax)
+    return 0;
+
+  Max = (Size + RECORD_PAD + 4095) & ~(size_t) 4095;
+  if ((Buf = realloc(F->Buf, Max)) == NULL)
+    return 1;
+
+  F->Buf = Buf;
+  F->BufMax = Max;
+
+  return 0;
+}
+
+
+void ReadRecord(struct RecordFile *F) {
+  struct stat st;
+  ssize_t n = 1;
+
+  F->Len = 0;
+  F->Failure = READ_OK;
+
+  if (stat(F->Name, &st) < 0) {
+    F->Failure = READ_NO_STAT;
+    return;
+  }
+
+  if ((F->fd = open(F->Name, O_RDONLY | O_CLOEXEC)) < 0) {
+    F->Failure = READ_NO_OPEN;
+    return;
+  }
+
+  if (GrowBuffer(F, st.st_size) != 0) {
+    F->Failure = READ_NO_MEMORY;
+  } else {
+    while ((F->Len < (size_t) st.st_size) && (n > 0)) {
+      n = read(F->fd, F->Buf + F->Len, st.st_size - F->Len);
+      if (n > 0)
+        F->Len += n;
+      else if ((n < 0) && (errno == EINTR))
+        n = 1;
+    }
+    if (n < 0)
+      F->Failure = READ_NO_READ;
+    else
+      memset(F->Buf + F->Len, 0, RECORD_PAD);
+  }
+
+  close(F->fd);
+  F->fd = -1;
+}
+
+
+void FreeRecord(struct RecordFile *F) {
+  free(F->Buf);
+  F->Buf = NULL;
+  F->BufMax = 0;
+}
+
+
+/**************************************
+
+           io_uring reading
+
+  A window of records takes two trips
+  to the kernel: all the opens and the
+  statx calls go in one, then all the
+  reads, each hard linked with its
+  close, go in the other. The ring is
+  driven by raw system calls, a kernel
+  without IORING_FEAT_RW_CUR_POS (all
+  before 5.6) lacks these operations.
+  Records too big for one read are read
+  by ReadRecord() after the window.
+
+**************************************/
+
+#define RING_READ_MAX (1U << 30)
+
+enum RingOps {
+  OP_OPEN,
+  OP_STAT,
+  OP_READ,
+  OP_CLOSE
+};
+
+struct BulkRing {
+  int fd;
+  unsigned int *SqTail;
+  unsigned int *SqMask;
+  unsigned int *SqArray;
+  unsigned int *CqHead;
+  unsigned int *CqTail;
+  unsigned int *CqMask;
+  struct io_uring_sqe *Sqe;
+  struct io_uring_cqe *Cqe;
+  void *SqMap;
+  void *CqMap;
+  size_t SqMapLen;
+  size_t CqMapLen;
+  size_t SqeLen;
+  unsigned int Tail;           /* queued entries, published by RingRun() */
+  unsigned int Pending;        /* submitted entries not completed yet */
+  int StatRes[BULK_WINDOW];
+  unsigned char Large[BULK_WINDOW];
+  struct statx Stx[BULK_WINDOW];
+};
+
+
+static void RingFree(struct BulkRing *R) {
+  if (R->Sqe != MAP_FAILED)
+    munmap(R->Sqe, R->SqeLen);
+  if ((R->CqMap != MAP_FAILED) && (R->CqMap != R->SqMap))
+    munmap(R->CqMap, R->CqMapLen);
+  if (R->SqMap != MAP_FAILED)
+    munmap(R->SqMap, R->SqMapLen);
+  close(R->fd);
+  free(R);
+}
+
+
+/* NULL if io_uring is missing, disabled or too old */
+
+static struct BulkRing *RingSetup(void) {
+  struct io_uring_params p;
+  struct BulkRing *R = calloc(1, sizeof(struct BulkRing));
+
+  if (R == NULL)
+    return NULL;
+
+  memset(&p, 0, sizeof(p));
+  R->fd = syscall(__NR_io_uring_setup, BULK_WINDOW * 2, &p);
+  if (R->fd < 0) {
+    free(R);
+    return NULL;
+  }
+
+  R->SqMap = R->CqMap = R->Sqe = MAP_FAILED;
+
+  if (!(p.features & IORING_FEAT_RW_CUR_POS) || (p.sq_entries < BULK_WINDOW * 2)) {
+    RingFree(R);
+    return NULL;
+  }
+
+  R->SqMapLen = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+  R->CqMapLen = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  R->SqeLen = p.sq_entries * sizeof(struct io_uring_sqe);
+
+  if ((p.features & IORING_FEAT_SINGLE_MMAP) && (R->CqMapLen > R->SqMapLen))
+    R->SqMapLen = R->CqMapLen;
+
+  R->SqMap = mmap(NULL, R->SqMapLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, R->fd, IORING_OFF_SQ_RING);
+  if (p.features & IORING_FEAT_SINGLE_MMAP)
+    R->CqMap = R->SqMap;
+  else
+    R->CqMap = mmap(NULL, R->CqMapLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, R->fd, IORING_OFF_CQ_RING);
+  R->Sqe = mmap(NULL, R->SqeLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, R->fd, IORING_OFF_SQES);
+
+  if ((R->SqMap == MAP_FAILED) || (R->CqMap == MAP_FAILED) || (R->Sqe == MAP_FAILED)) {
+    RingFree(R);
+    return NULL;
+  }
+
+  R->SqTail = (unsigned int *) ((char *) R->SqMap + p.sq_off.tail);
+  R->SqMask = (unsigned int *) ((char *) R->SqMap + p.sq_off.ring_mask);
+  R->SqArray = (unsigned int *) ((char *) R->SqMap + p.sq_off.array);
+  R->CqHead = (unsigned int *) ((char *) R->CqMap + p.cq_off.head);
+  R->CqTail = (unsigned int *) ((char *) R->CqMap + p.cq_off.tail);
+  R->CqMask = (unsigned int *) ((char *) R->CqMap + p.cq_off.ring_mask);
+  R->Cqe = (struct io_uring_cqe *) ((char *) R->CqMap + p.cq_off.cqes);
+  R->Tail = *R->SqTail;
+
+  return R;
+}
+
+
+static struct io_uring_sqe *QueueOp(struct BulkRing *R, unsigned int Op, unsigned int i, int fd) {
+  unsigned int Slot = R->Tail++ & *R->SqMask;
+  struct io_uring_sqe *S = R->Sqe + Slot;
+
+  memset(S, 0, sizeof(struct io_uring_sqe));
+  S->fd = fd;
+  S->user_data = (i << 2) | Op;
+  R->SqArray[Slot] = Slot;
+
+  return S;
+}
+
+
+static void Complete(struct BulkReader *B, unsigned long long Data, int Res) {
+  struct RecordFile *F = B->File + (Data >> 2);
+
+  switch (Data & 3) {
+    case OP_OPEN:
+      F->fd = Res;
+      break;
+    case OP_STAT:
+      B->Ring->StatRes[Data >> 2] = Res;
+      break;
+    case OP_READ:
+      if (Res < 0)
+        F->Failure = READ_NO_READ;
+      else
+        F->Len = Res;
+      break;
+    case OP_CLOSE:
+      F->fd = -1;
+      break;
+  }
+}
+
+
+static void RingReap(struct BulkReader *B) {
+  struct BulkRing *R = B->Ring;
+  struct io_uring_cqe *C;
+  unsigned int Head = *R->CqHead;
+
+  while (Head != __atomic_load_n(R->CqTail, __ATOMIC_ACQUIRE)) {
+    C = R->Cqe + (Head & *R->CqMask);
+    Complete(B, C->user_data, C->res);
+    Head++;
+    R->Pending--;
+  }
+  __atomic_store_n(R->CqHead, Head, __ATOMIC_RELEASE);
+}
+
+
+/* Submits Count queued entries and waits for them all, Pending is left on failure */
+
+static int RingRun(struct BulkReader *B, unsigned int Count) {
+  struct BulkRing *R = B->Ring;
+  int n;
+
+  __atomic_store_n(R->SqTail, R->Tail, __ATOMIC_RELEASE);
+
+  while (Count + R->Pending > 0) {
+    n = syscall(__NR_io_uring_enter, R->fd, Count, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+    if (n > 0) {
+      Count -= n;
+      R->Pending += n;
+    } else if (((n < 0) && (errno != EINTR)) || ((n == 0) && (R->Pending == 0))) {
+      return 1;
+    }
+    RingReap(B);
+  }
+
+  return 0;
+}
+
+
+/*
+  After a failed RingRun() waits for the submitted entries, entries
+  never submitted are dropped with the ring. 1 if the kernel keeps
+  failing: then requests may still be running.
+*/
+
+static int RingDrain(struct BulkReader *B) {
+  struct BulkRing *R = B->Ring;
+  int n;
+
+  while (R->Pending > 0) {
+    n = syscall(__NR_io_uring_enter, R->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+    if ((n < 0) && (errno != EINTR))
+      return 1;
+    RingReap(B);
+  }
+
+  return 0;
+}
+
+
+static int RingRead(struct BulkReader *B, unsigned int Num) {
+  struct BulkRing *R = B->Ring;
+  struct RecordFile *F;
+  struct io_uring_sqe *S;
+  unsigned int i, Count = 0;
+
+  for (i = 0; i < Num; i++) {
+    S = QueueOp(R, OP_OPEN, i, AT_FDCWD);
+    S->opcode = IORING_OP_OPENAT;
+    S->addr = (unsigned long) B->File[i].Name;
+    S->open_flags = O_RDONLY | O_CLOEXEC;
+
+    S = QueueOp(R, OP_STAT, i, AT_FDCWD);
+    S->opcode = IORING_OP_STATX;
+    S->addr = (unsigned long) B->File[i].Name;
+    S->len = STATX_SIZE;
+    S->addr2 = (unsigned long) (R->Stx + i);
+  }
+
+  if (RingRun(B, 2 * Num) != 0)
+    return 1;
+
+  for (i = 0; i < Num; i++) {
+    F = B->File + i;
+    R->Large[i] = 0;
+    if (R->StatRes[i] < 0)
+      F->Failure = READ_NO_STAT;
+    else if (F->fd < 0)
+      F->Failure = READ_NO_OPEN;
+    else if (R->Stx[i].stx_size > RING_READ_MAX)
+      R->Large[i] = 1;
+    else if (GrowBuffer(F, R->Stx[i].stx_size) != 0)
+      F->Failure = READ_NO_MEMORY;
+
+    if ((F->Failure == READ_OK) && !R->Large[i]) {
+      S = QueueOp(R, OP_READ, i, F->fd);
+      S->opcode = IORING_OP_READ;
+      S->flags = IOSQE_IO_HARDLINK;
+      S->addr = (unsigned long) F->Buf;
+      S->len = R->Stx[i].stx_size;
+      Count++;
+    }
+    if (F->fd >= 0) {
+      S = QueueOp(R, OP_CLOSE, i, F->fd);
+      S->opcode = IORING_OP_CLOSE;
+      Count++;
+    }
+  }
+
+  if (RingRun(B, Count) != 0)
+    return 1;
+
+  for (i = 0; i < Num; i++) {
+    F = B->File + i;
+    if (F->Failure != READ_OK)
+      continue;
+    if (R->Large[i])
+      ReadRecord(F);
+    else
+      memset(F->Buf + F->Len, 0, RECORD_PAD);
+  }
+
+  return 0;
+}
+
+
+/**************************************
+
+            Thread reading
+
+  Without io_uring the records of a
+  window are read by a pool of threads
+  with blocking calls, the calling
+  thread being one of them. The pool
+  is started by the first such window.
+
+**************************************/
+
+static void *BulkWorker(void *Arg) {
+  struct BulkReader *B = Arg;
+  unsigned int i;
+
+  pthread_mutex_lock(&B->Lock);
+
+  for (;;) {
+    while ((B->Next >= B->Num) && (!B->Quit))
+      pthread_cond_wait(&B->Work, &B->Lock);
+
+    if (B->Quit)
+      break;
+
+    i = B->Next++;
+    B->Busy++;
+    pthread_mutex_unlock(&B->Lock);
+
+    ReadRecord(B->File + i);
+
+    pthread_mutex_lock(&B->Lock);
+    if ((--B->Busy == 0) && (B->Next >= B->Num))
+      pthread_cond_broadcast(&B->Done);
+  }
+
+  pthread_mutex_unlock(&B->Lock);
+
+  return NULL;
+}
+
+
+static void StartPool(struct BulkReader *B) {
+  unsigned int Jobs = B->Jobs;
+
+  B->Pooled = 1;
+
+  if (Jobs == 0) {
+    long N = sysconf(_SC_NPROCESSORS_ONLN);
+    Jobs = (N > 0) ? N : 1;
+  }
+
+  if (Jobs > 1)
+    B->Worker = calloc(Jobs - 1, sizeof(pthread_t));
+
+  for (B->Started = 0; B->Worker && (B->Started + 1 < Jobs); B->Started++) {
+    if (pthread_create(B->Worker + B->Started, NULL, BulkWorker, B) != 0)
+      break;
+  }
+}
+
+
+/* files are taken under the lock, so none is touched once the window is done */
+
+static void PoolRead(struct BulkReader *B, unsigned int Num) {
+  unsigned int i;
+
+  if (!B->Pooled)
+    StartPool(B);
+
+  pthread_mutex_lock(&B->Lock);
+  B->Num = Num;
+  B->Next = 0;
+  pthread_cond_broadcast(&B->Work);
+
+  while (B->Next < B->Num) {
+    i = B->Next++;
+    B->Busy++;
+    pthread_mutex_unlock(&B->Lock);
+
+    ReadRecord(B->File + i);
+
+    pthread_mutex_lock(&B->Lock);
+    B->Busy--;
+  }
+
+  while (B->Busy > 0)
+    pthread_cond_wait(&B->Done, &B->Lock);
+  pthread_mutex_unlock(&B->Lock);
+}
+
+
+/**************************************
+
+               BulkRead
+
+**************************************/
+
+/*
+  The ring failed amid a window: once the submitted requests are done,
+  the descriptors they opened and did not close are closed here. If they
+  can not be waited for, the window's buffers and descriptors are left
+  to them and never reused.
+*/
+
+static void RingFail(struct BulkReader *B, unsigned int Num) {
+  unsigned int i;
+
+  if (RingDrain(B) == 0) {
+    for (i = 0; i < Num; i++) {
+      if (B->File[i].fd >= 0)
+        close(B->File[i].fd);
+    }
+  } else {
+    for (i = 0; i < Num; i++) {
+      B->File[i].Buf = NULL;
+      B->File[i].BufMax = 0;
+    }
+  }
+
+  RingFree(B->Ring);
+  B->Ring = NULL;
+}
+
+
+/* Jobs - reading threads without io_uring, 0 - one per CPU */
+
+void BulkInit(struct BulkReader *B, unsigned int Jobs) {
+  memset(B, 0, sizeof(struct BulkReader));
+
+  pthread_mutex_init(&B->Lock, NULL);
+  pthread_cond_init(&B->Work, NULL);
+  pthread_cond_init(&B->Done, NULL);
+
+  B->Jobs = Jobs;
+  B->Ring = RingSetup();
+}
+
+
+/* Num up to BULK_WINDOW, the names are kept till the next call */
+
+void BulkRead(struct BulkReader *B, char **Name, unsigned int Num) {
+  unsigned int i;
+
+  for (i = 0; i < Num; i++) {
+    B->File[i].Name = Name[i];
+    B->File[i].Len = 0;
+    B->File[i].Failure = READ_OK;
+    B->File[i].fd = -1;
+  }
+
+  if (B->Ring) {
+    if (RingRead(B, Num) == 0)
+      return;
+    RingFail(B, Num);
+  }
+
+  PoolRead(B, Num);
+}
+
+
+void BulkFree(struct BulkReader *B) {
+  unsigned int i;
+
+  pthread_mutex_lock(&B->Lock);
+  B->Quit = 1;
+  pthread_cond_broadcast(&B->Work);
+  pthread_mutex_unlock(&B->Lock);
+
+  for (i = 0; i < B->Started; i++)
+    pthread_join(B->Worker[i], NULL);
+
+  free(B->Worker);
+
+  if (B->Ring)
+    RingFree(B->Ring);
+
+  for (i = 0; i < BULK_WINDOW; i++)
+    FreeRecord(B->File + i);
+
+  pthread_cond_destroy(&B->Done);
+  pthread_cond_destroy(&B->Work);
+  pthread_mutex_destroy(&B->Lock);
+}
+
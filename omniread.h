@@ -0,0 +1,54 @@
+#ifndef _OMNIREAD_H
+
+#define _OMNIREAD_H 1
+
+#include <stddef.h>
+#include <pthread.h>
+
+#define BULK_WINDOW 64         /* records read at once */
+#define RECORD_PAD 16          /* zeroes past a record, the text scanner loads 16 bytes at once */
+
+enum ReadFailures {
+  READ_OK,
+  READ_NO_STAT,
+  READ_NO_OPEN,
+  READ_NO_READ,
+  READ_NO_MEMORY
+};
+
+struct RecordFile {            /* one record read in whole */
+  char *Name;
+  char *Buf;                   /* Len bytes and RECORD_PAD zeroes, kept for the next record */
+  size_t BufMax;
+  size_t Len;
+  int Failure;
+  int fd;
+};
+
+struct BulkRing;
+
+struct BulkReader {
+  struct RecordFile File[BULK_WINDOW];
+  struct BulkRing *Ring;       /* NULL - read by the threads */
+  pthread_mutex_t Lock;
+  pthread_cond_t Work;         /* new window or quitting */
+  pthread_cond_t Done;         /* the window is read */
+  pthread_t *Worker;
+  unsigned int Jobs;
+  int Pooled;                  /* the threads were started */
+  unsigned int Started;
+  unsigned int Num;            /* files of the window, with the lock */
+  unsigned int Next;           /* file to be taken, with the lock */
+  unsigned int Busy;           /* files being read */
+  int Quit;
+};
+
+void ReadRecord(struct RecordFile *F);
+void FreeRecord(struct RecordFile *F);
+
+void BulkInit(struct BulkReader *R, unsigned int Jobs);
+void BulkRead(struct BulkReader *R, char **Name, unsigned int Num);
+void BulkFree(struct BulkReader *R);
+
+#endif
+
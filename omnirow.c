@@ -0,0 +1,112 @@
+#include <string.h>
+
+#include "omnirow.h"
+
+
+/**************************************
+
+          Multi-word glass rows
+
+  Column c is bit (c % ROW_BITS) of
+  word (c / ROW_BITS). Whole-row
+  kernels take 128 bits per step with
+  SSE2, 64 bits otherwise.
+
+**************************************/
+
+static unsigned long long Load64(const unsigned int *W) {
+  unsigned long long V;
+
+  memcpy(&V, W, sizeof(V));
+
+  return V;
+}
+
+
+unsigned int RowCount(const unsigned int *Row, unsigned int Words) {
+  unsigned int i, n = 0;
+
+  for (i = 0; i + 2 <= Words; i += 2)
+    n += __builtin_popcountll(Load64(Row + i));
+  if (i < Words)
+    n += __builtin_popcount(Row[i]);
+
+  return n;
+}
+
+
+/* Adds Row to the Covered cells above, returns the covered empty cells of Row */
+
+unsigned int RowCover(unsigned int *Covered, const unsigned int *Row, unsigned int Words) {
+  unsigned int i = 0, n = 0;
+
+#ifdef __SSE2__
+  for (; i + 4 <= Words; i += 4) {
+    __m128i R = _mm_loadu_si128((const __m128i *) (Row + i));
+    __m128i C = _mm_or_si128(_mm_loadu_si128((const __m128i *) (Covered + i)), R);
+    unsigned int H[4];
+
+    _mm_storeu_si128((__m128i *) (Covered + i), C);
+    _mm_storeu_si128((__m128i *) H, _mm_andnot_si128(R, C));
+    n += __builtin_popcountll(Load64(H)) + __builtin_popcountll(Load64(H + 2));
+  }
+#endif
+
+  for (; i < Words; i++) {
+    Covered[i] |= Row[i];
+    n += __builtin_popcount(Covered[i] & ~Row[i]);
+  }
+
+  return n;
+}
+
+
+
+/**************************************
+
+           Row images
+
+  Every glass cell is drawn as two
+  characters, "[]" or "  ", four cells
+  at once through the nibble table.
+  Empty and full words are filled
+  without looking at their bits.
+
+**************************************/
+
+#define CELL_CHARS 2
+
+static const char NibbleImage[16][4 * CELL_CHARS + 1] = {
+  "        ", "[]      ", "  []    ", "[][]    ",
+  "    []  ", "[]  []  ", "  [][]  ", "[][][]  ",
+  "      []", "[]    []", "  []  []", "[][]  []",
+  "    [][]", "[]  [][]", "  [][][]", "[][][][]"
+};
+
+static const char FullImage[ROW_BITS * CELL_CHARS + 1] =
+  "[][][][][][][][][][][][][][][][][][][][][][][][][][][][][][][][]";
+
+
+/* Writes N * 2 characters */
+
+void PutRowImage(const unsigned int *Row, char *Image, unsigned int N) {
+  unsigned int c, n, W;
+
+  for (c = 0; c + ROW_BITS <= N; c += ROW_BITS, Image += ROW_BITS * CELL_CHARS) {
+    W = *Row++;
+    if (W == 0) {
+      memset(Image, ' ', ROW_BITS * CELL_CHARS);
+    } else if (W == ~0u) {
+      memcpy(Image, FullImage, ROW_BITS * CELL_CHARS);
+    } else {
+      for (n = 0; n < ROW_BITS; n += 4, W >>= 4)
+        memcpy(Image + n * CELL_CHARS, NibbleImage[W & 15], 4 * CELL_CHARS);
+    }
+  }
+
+  if (c < N) {
+    for (W = *Row; c + 4 <= N; c += 4, W >>= 4, Image += 4 * CELL_CHARS)
+      memcpy(Image, NibbleImage[W & 15], 4 * CELL_CHARS);
+    memcpy(Image, NibbleImage[W & 15], (N - c) * CELL_CHARS);
+  }
+}
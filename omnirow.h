@@ -0,0 +1,119 @@
+#ifndef _OMNIROW_H
+
+#define _OMNIROW_H 1
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "omnitype.h"
+
+#define RowWordsOf(Width) (((Width) + ROW_BITS - 1) / ROW_BITS)
+
+unsigned int RowCount(const unsigned int *Row, unsigned int Words);
+unsigned int RowCover(unsigned int *Covered, const unsigned int *Row, unsigned int Words);
+void PutRowImage(const unsigned int *Row, char *Image, unsigned int N);
+
+
+/*
+  Figure mask and per-cell kernels are inlined, they run at every step
+  of a fall. A mask is at most MAX_FIGURE_SIZE wide and touches two
+  words of a row at most, M->Left is the glass column of its bit 0.
+*/
+
+struct RowMask {               /* figure mask shifted into row words */
+  unsigned int Word;           /* of the mask bit 0 */
+  unsigned int Height;
+  int Straddles;               /* Hi words are used */
+  unsigned int Lo[MAX_FIGURE_SIZE];
+  unsigned int Hi[MAX_FIGURE_SIZE];
+};
+
+#define MASK_COLUMN 0x0101010101010101ULL /* column 0 of FigureMask Bits */
+
+static inline unsigned int MaskRow(const struct FigureMask *M, unsigned int i) {
+  return (unsigned int) (M->Bits >> (i * 8)) & 0xff;
+}
+
+static inline void ShiftMask(const struct FigureMask *M, struct RowMask *S) {
+  unsigned int i, Shift = (unsigned int) M->Left % ROW_BITS;
+
+  S->Word = (unsigned int) M->Left / ROW_BITS;
+  S->Height = M->Height;
+  S->Straddles = (Shift + M->Width) > ROW_BITS;
+
+  for (i = 0; i < M->Height; i++) {
+    S->Lo[i] = MaskRow(M, i) << Shift;
+    S->Hi[i] = Shift ? (MaskRow(M, i) >> (ROW_BITS - Shift)) : 0;
+  }
+}
+
+/* Row is the glass row of the mask bottom */
+
+static inline int MaskOverlaps(const unsigned int *Row, unsigned int Words, const struct RowMask *S) {
+  const unsigned int *W = Row + S->Word;
+  unsigned int i;
+
+  if (S->Straddles) {
+    for (i = 0; i < S->Height; i++, W += Words) {
+      if ((W[0] & S->Lo[i]) | (W[1] & S->Hi[i]))
+        return 1;
+    }
+  } else {
+    for (i = 0; i < S->Height; i++, W += Words) {
+      if (W[0] & S->Lo[i])
+        return 1;
+    }
+  }
+
+  return 0;
+}
+
+static inline void MaskPlace(unsigned int *Row, unsigned int Bits, int Left) {
+  unsigned int *W = Row + (unsigned int) Left / ROW_BITS;
+  unsigned long long B = (unsigned long long) Bits << ((unsigned int) Left % ROW_BITS);
+
+  W[0] |= (unsigned int) B;
+  if (B >> ROW_BITS)
+    W[1] |= (unsigned int) (B >> ROW_BITS);
+}
+
+/* Full row test, once per row touched by a dropped figure */
+
+static inline int RowEqual(const unsigned int *A, const unsigned int *B, unsigned int Words) {
+  unsigned int i = 0;
+
+#ifdef __SSE2__
+  for (; i + 4 <= Words; i += 4) {
+    __m128i E = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *) (A + i)),
+                                _mm_loadu_si128((const __m128i *) (B + i)));
+    if (_mm_movemask_epi8(E) != 0xffff)
+      return 0;
+  }
+#endif
+
+  for (; i < Words; i++) {
+    if (A[i] != B[i])
+      return 0;
+  }
+
+  return 1;
+}
+
+static inline void CopyRow(unsigned int *Dst, const unsigned int *Src, unsigned int Words) {
+  unsigned int i;
+
+  for (i = 0; i < Words; i++)
+    Dst[i] = Src[i];
+}
+
+static inline int RowBit(const unsigned int *Row, unsigned int Column) {
+  return (Row[Column / ROW_BITS] >> (Column % ROW_BITS)) & 1;
+}
+
+static inline void SetRowBit(unsigned int *Row, unsigned int Column) {
+  Row[Column / ROW_BITS] |= 1u << (Column % ROW_BITS);
+}
+
+#endif
+
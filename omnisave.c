@@ -6,6 +6,7 @@
 #include "md5hash.h"
 
 #include "omnitype.h"
+#include "omnimem.h"
 
 #include "omnimino.def"
 
@@ -15,12 +16,7 @@
 
 **************************************/
 
-
-static char *StorePtr;
-
-static int StoreFree;
-
-static void Adjust(int Done) {
+static void Adjust(struct Omnimino *GG, int Done) {
   if (Done >= StoreFree)
     Done = StoreFree;
 
@@ -30,48 +26,50 @@ static void Adjust(int Done) {
   StorePtr += Done;
 }
 
-static void StoreInt(int V, int Delim) {
-  Adjust(snprintf(StorePtr, StoreFree, "%d%c", V, (char)Delim));
+static void StoreInt(struct Omnimino *GG, int V, int Delim) {
+  Adjust(GG, snprintf(StorePtr, StoreFree, "%d%c", V, (char)Delim));
 }
 
-static void StoreUnsigned(unsigned int V, int Delim) {
-  Adjust(snprintf(StorePtr, StoreFree, "%u%c", V, (char)Delim));
+static void StoreUnsigned(struct Omnimino *GG, unsigned int V, int Delim) {
+  Adjust(GG, snprintf(StorePtr, StoreFree, "%u%c", V, (char)Delim));
 }
 
-static void StoreString(char *S) {
-  Adjust(snprintf(StorePtr, StoreFree, "%s\n", S));
+static void StoreLong(struct Omnimino *GG, unsigned long long V, int Delim) {
+  Adjust(GG, snprintf(StorePtr, StoreFree, "%llu%c", V, (char)Delim));
 }
 
+static void StoreString(struct Omnimino *GG, char *S) {
+  Adjust(GG, snprintf(StorePtr, StoreFree, "%s\n", S));
+}
 
-void SaveGame(struct Omnimino *GG){
-  unsigned int *UPtr = (unsigned int *) (&(GG->P));
-  unsigned int i; 
-  int Used;
-  char *UserName;
-
-  FILE *fout;
 
+/* Text record, the name is the md5 of the whole record */
 
-  if (GameType == 3)
-    return;
+static int StoreText(struct Omnimino *GG) {
+  unsigned int *UPtr = (unsigned int *) (&(GG->P));
+  unsigned int i, j;
+  int Used;
 
-  StorePtr = (char *) GlassRow;
+  StorePtr = (char *) GlassBuf;
   StoreFree = StoreBufSize;
 
   do {
     for (i = 0; i < PARNUM; i++, UPtr++)
-      StoreUnsigned(*UPtr, '\n');
+      StoreUnsigned(GG, *UPtr, '\n');
 
     if ((GameType == 2) && (FillRatio != 0))
         break;
 
-    StoreString(ParentName);
-    StoreInt((int)(LastFigure - Figure), '\n');
-    StoreInt((int)(NextFigure - Figure), '\n');
+    StoreString(GG, ParentName);
+    StoreInt(GG, (int)(LastFigure - Figure), '\n');
+    StoreInt(GG, (int)(NextFigure - Figure), '\n');
 
-    for (i = 0; i < FillLevel; i++)
-      StoreUnsigned(FillBuf[i], ';');
-    StoreString("");
+    for (i = 0; i < FillLevel * RowWords; i += RowWords) {
+      for (j = 1; j < RowWords; j++) /* wide rows, lower words first */
+        StoreUnsigned(GG, FillBuf[i + j - 1], ',');
+      StoreUnsigned(GG, FillBuf[i + j - 1], ';');
+    }
+    StoreString(GG, "");
 
     if (GameType == 2)
       break;
@@ -79,30 +77,88 @@ void SaveGame(struct Omnimino *GG){
     struct Coord **F;
 
     for(F = Figure; F <= LastFigure; F++)
-      StoreInt((int)(*F - Block), ';');
-    StoreString("");
+      StoreInt(GG, (int)(*F - Block), ';');
+    StoreString(GG, "");
 
     struct Coord *B;
 
     for(B = Block; B < (*LastFigure); B++) {
-      StoreInt(B->x, ',');
-      StoreInt(B->y, ';');
+      StoreInt(GG, B->x, ',');
+      StoreInt(GG, B->y, ';');
     }
-    StoreString("");
+    StoreString(GG, "");
 
-    UserName = getenv("USER");
-    if (!UserName)
-      UserName = "anonymous";
-    snprintf(PlayerName,OM_STRLEN,"%s",UserName);
-    StoreString(PlayerName);
-
-    TimeStamp = (unsigned int)time(NULL);
-    StoreUnsigned(TimeStamp, '\n');
+    StoreString(GG, PlayerName);
+    StoreUnsigned(GG, TimeStamp, '\n');
+    if (Seed != 0) /* none in records older than the seed */
+      StoreLong(GG, Seed, '\n');
+    if (Generator != FIGURES_GROWN)
+      StoreUnsigned(GG, Generator, '\n');
 
   } while(0);
 
   Used = StoreBufSize - StoreFree;
-  md5hash(GlassRow, Used, GameName);
+  md5hash(GlassBuf, Used, GameName);
+
+  return Used;
+}
+
+
+/* Binary record, the name is the md5 of everything past the Hash field */
+
+static int StoreBinary(struct Omnimino *GG) {
+  struct OmniBinHeader *H = (struct OmniBinHeader *) GlassBuf;
+  unsigned int i, *U = (unsigned int *) (H + 1);
+  struct Coord **F, *B;
+  short *XY;
+  int Used;
+
+  memset(H, 0, sizeof(struct OmniBinHeader));
+  memcpy(H->Magic, BIN_MAGIC, sizeof(H->Magic));
+  H->Version = BIN_VERSION;
+  memcpy(H->Parms, &(GG->P), sizeof(H->Parms));
+  snprintf(H->Parent, OM_STRLEN + 1, "%s", ParentName);
+
+  if ((GameType == 1) || (FillRatio == 0)) {
+    H->FillNum = FillLevel;
+    for (i = 0; i < FillLevel * RowWords; i++)
+      *U++ = FillBuf[i];
+  }
+
+  if (GameType == 1) {
+    H->FigureNum = LastFigure - Figure;
+    H->NextNum = NextFigure - Figure;
+    H->BlockNum = *LastFigure - Block;
+    H->Stamp = TimeStamp;
+    H->FigureSeed = Seed;
+    H->FigureSource = Generator;
+    snprintf(H->Player, OM_STRLEN + 1, "%s", PlayerName);
+
+    for (F = Figure; F <= LastFigure; F++)
+      *U++ = *F - Block;
+
+    for (B = Block, XY = (short *) U; B < (*LastFigure); B++) {
+      if ((B->x != (short) B->x) || (B->y != (short) B->y)) {
+        snprintf(MsgBuf, OM_STRLEN, "Block %d out of binary range.", (int)(B - Block));
+        return -1;
+      }
+      *XY++ = B->x;
+      *XY++ = B->y;
+    }
+    U = (unsigned int *) XY;
+  }
+
+  Used = (char *) U - (char *) H;
+  md5hash(((char *) H) + BIN_HASHED_PART, Used - BIN_HASHED_PART, GameName);
+  memcpy(H->Hash, GameName, sizeof(H->Hash));
+
+  return Used;
+}
+
+
+static void WriteRecord(struct Omnimino *GG, int Used) {
+  FILE *fout;
+
   if (GameType == 2)
     strcat(GameName, ".preset");
   strcat(GameName, ".mino");
@@ -112,7 +168,7 @@ void SaveGame(struct Omnimino *GG){
     snprintf(MsgBuf, OM_STRLEN, "Can not open for write %s.", GameName);
     GameType = 3;
   } else {
-    if(fwrite(GlassRow, sizeof(char), Used, fout) != (size_t)Used) {
+    if(fwrite(GlassBuf, sizeof(char), Used, fout) != (size_t)Used) {
       snprintf(MsgBuf, OM_STRLEN, "Error writing %s.", GameName);
       GameType = 3;
     }
@@ -120,3 +176,57 @@ void SaveGame(struct Omnimino *GG){
   }
 }
 
+
+static void SaveRecord(struct Omnimino *GG, int Format) {
+  int Used = (Format == FORMAT_BINARY) ? StoreBinary(GG) : StoreText(GG);
+
+  if (Used < 0)
+    GameType = 3;
+  else
+    WriteRecord(GG, Used);
+}
+
+
+void SaveGame(struct Omnimino *GG){
+  char *UserName;
+
+  if (GameType == 3)
+    return;
+
+  if (GameType == 1) {
+    UserName = getenv("USER");
+    if (!UserName)
+      UserName = "anonymous";
+    snprintf(PlayerName,OM_STRLEN,"%s",UserName);
+
+    TimeStamp = (unsigned int)time(NULL);
+  }
+
+  SaveRecord(GG, RecordFormat);
+}
+
+
+/**************************************
+
+           ExportGame
+
+  Rewrites a loaded record in the given
+  format keeping player and time stamp.
+
+**************************************/
+
+void ExportGame(struct Omnimino *GG, int Format){
+  if (GameType == 3)
+    return;
+
+  if (GameType == 2) { /* presets are loaded without buffers */
+    if (AllocateBuffers(GG)) {
+      GameType = 3;
+      return;
+    }
+    LastFigure = NextFigure = Figure;
+  }
+
+  SaveRecord(GG, Format);
+}
+
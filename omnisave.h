@@ -5,6 +5,7 @@
 #include "omnitype.h"
 
 void SaveGame(struct Omnimino *G);
+void ExportGame(struct Omnimino *G, int Format);
 
 #endif
 
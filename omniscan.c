@@ -0,0 +1,198 @@
+#define _GNU_SOURCE 1
+
+#include <features.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/syscall.h>
+
+#include "omniscan.h"
+
+/**************************************
+
+          Records directory scan
+
+  Every directory is read with raw
+  getdents64 calls in big chunks, no
+  stat per entry, and the names ending
+  in ".mino" are kept the way the shell
+  globs them, hidden ones skipped. The
+  paths of one directory are sorted by
+  inode, which mostly is the order of
+  the records on the disk.
+
+**************************************/
+
+#define DENTS_BUF 65536
+
+struct DirEntry64 {            /* as filled by getdents64 */
+  unsigned long long d_ino;
+  long long d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[];
+};
+
+
+static int IsRecordName(const char *Name, unsigned char Type) {
+  size_t Len = strlen(Name);
+
+  if ((Type != DT_REG) && (Type != DT_LNK) && (Type != DT_UNKNOWN))
+    return 0;
+
+  return (Name[0] != '.') && (Len > 5) && (strcmp(Name + Len - 5, ".mino") == 0);
+}
+
+
+static int AddName(struct NameList *L, const char *Dir, size_t DirLen, const char *Name,
+                   unsigned long long Ino) {
+  size_t Len = DirLen + 1 + strlen(Name) + 1;
+
+  if (L->BufLen + Len > L->BufMax) {
+    size_t Max = L->BufMax ? L->BufMax * 2 : DENTS_BUF;
+    char *Buf;
+
+    while (L->BufLen + Len > Max)
+      Max *= 2;
+    if ((Buf = realloc(L->Buf, Max)) == NULL)
+      return 1;
+    L->Buf = Buf;
+    L->BufMax = Max;
+  }
+
+  if (L->Num == L->Max) {
+    unsigned long Max = L->Max ? L->Max * 2 : 1024;
+    struct NameEntry *Entry = realloc(L->Entry, Max * sizeof(struct NameEntry));
+
+    if (Entry == NULL)
+      return 1;
+    L->Entry = Entry;
+    L->Max = Max;
+  }
+
+  L->Entry[L->Num].Ino = Ino;
+  L->Entry[L->Num].Path = L->BufLen;
+  L->Num++;
+
+  memcpy(L->Buf + L->BufLen, Dir, DirLen);
+  L->Buf[L->BufLen + DirLen] = '/';
+  strcpy(L->Buf + L->BufLen + DirLen + 1, Name);
+  L->BufLen += Len;
+
+  return 0;
+}
+
+
+static int ByInode(const void *A, const void *B) {
+  unsigned long long a = ((const struct NameEntry *) A)->Ino;
+  unsigned long long b = ((const struct NameEntry *) B)->Ino;
+
+  return (a > b) - (a < b);
+}
+
+
+static int ScanDir(struct NameList *L, char *Dir, char *Buf) {
+  struct DirEntry64 *D;
+  unsigned long First = L->Num;
+  size_t DirLen = strlen(Dir);
+  long n, i;
+  int Err = 0;
+  int fd = openat(AT_FDCWD, Dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+  if (fd < 0) {
+    fprintf(stderr, "Can not open directory %s.\n", Dir);
+    return 1;
+  }
+
+  while ((DirLen > 1) && (Dir[DirLen - 1] == '/'))
+    DirLen--;
+
+  while ((!Err) && ((n = syscall(SYS_getdents64, fd, Buf, DENTS_BUF)) > 0)) {
+    for (i = 0; (!Err) && (i < n); i += D->d_reclen) {
+      D = (struct DirEntry64 *) (Buf + i);
+      if (IsRecordName(D->d_name, D->d_type) && (AddName(L, Dir, DirLen, D->d_name, D->d_ino) != 0)) {
+        fprintf(stderr, "Out of memory listing directory %s.\n", Dir);
+        Err = 1;
+      }
+    }
+  }
+
+  if ((!Err) && (n < 0)) {
+    fprintf(stderr, "Can not read directory %s.\n", Dir);
+    Err = 1;
+  }
+
+  close(fd);
+
+  qsort(L->Entry + First, L->Num - First, sizeof(struct NameEntry), ByInode);
+
+  return Err;
+}
+
+
+/**************************************
+
+               ScanDirs
+
+**************************************/
+
+/* 1 if some directory failed, the records listed so far are kept */
+
+int ScanDirs(struct NameList *L, char **Dir, unsigned int DirNum) {
+  char *Buf = malloc(DENTS_BUF);
+  unsigned int i;
+  int Err = 0;
+
+  memset(L, 0, sizeof(struct NameList));
+
+  if (Buf == NULL) {
+    fprintf(stderr, "Out of memory listing directories.\n");
+    return 1;
+  }
+
+  for (i = 0; i < DirNum; i++)
+    Err |= ScanDir(L, Dir[i], Buf);
+
+  free(Buf);
+
+  return Err;
+}
+
+
+/* NULL when all the paths are taken */
+
+char *NextScanned(struct NameList *L) {
+  if (L->Next >= L->Num)
+    return NULL;
+
+  return L->Buf + L->Entry[L->Next++].Path;
+}
+
+
+/* all the paths in their order, NULL if out of memory */
+
+char **ScannedPaths(struct NameList *L) {
+  char **Path = malloc((L->Num + 1) * sizeof(char *));
+  unsigned long i;
+
+  if (Path == NULL)
+    return NULL;
+
+  for (i = 0; i < L->Num; i++)
+    Path[i] = L->Buf + L->Entry[i].Path;
+  Path[L->Num] = NULL;
+
+  return Path;
+}
+
+
+void FreeNames(struct NameList *L) {
+  free(L->Buf);
+  free(L->Entry);
+  memset(L, 0, sizeof(struct NameList));
+}
+
@@ -0,0 +1,28 @@
+#ifndef _OMNISCAN_H
+
+#define _OMNISCAN_H 1
+
+#include <stddef.h>
+
+struct NameEntry {
+  unsigned long long Ino;
+  size_t Path;                 /* offset into Buf */
+};
+
+struct NameList {              /* paths of the records found */
+  char *Buf;                   /* all the paths, NUL terminated */
+  size_t BufLen;
+  size_t BufMax;
+  struct NameEntry *Entry;     /* in inode order per directory */
+  unsigned long Num;
+  unsigned long Max;
+  unsigned long Next;          /* to be taken by the batch */
+};
+
+int ScanDirs(struct NameList *L, char **Dir, unsigned int DirNum);
+char *NextScanned(struct NameList *L);
+char **ScannedPaths(struct NameList *L);
+void FreeNames(struct NameList *L);
+
+#endif
+
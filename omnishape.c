@@ -0,0 +1,148 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "omnishape.h"
+
+/**************************************
+
+        Fixed figures catalogue
+
+  All the figures connected through
+  sides (Diagonal 0) or through corners
+  too (Diagonal 1) are listed with
+  Redelmeier's method, once per process
+  and weight. The first cell is (0, 0),
+  the leftmost one of the lowest row,
+  so every figure is listed once, and
+  cell (x, y) takes a byte.
+
+**************************************/
+
+#if MAX_FIGURE_SIZE > 8
+#error "figure cells do not fit in a byte"
+#endif
+
+#define CELL(x, y) ((unsigned char) (((x) + 8) | ((y) << 4)))
+#define CELL_X(c)  ((int) ((c) & 15) - 8)
+#define CELL_Y(c)  ((int) ((c) >> 4))
+
+static const int Step[8][2] = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}, {1, 1}, {-1, 1}, {-1, -1}, {1, -1}};
+
+struct Lister {
+  unsigned int MaxWeight;
+  unsigned int Directions;
+  unsigned int Count[MAX_FIGURE_SIZE + 1];
+  unsigned char *Out[MAX_FIGURE_SIZE + 1];  /* NULL - counted only */
+  unsigned char Cell[MAX_FIGURE_SIZE];
+  unsigned char Reached[256];               /* in the figure or untried */
+};
+
+
+static void Extend(struct Lister *L, unsigned char *Untried, unsigned int UntriedNum, unsigned int Weight) {
+  unsigned char Next[MAX_FIGURE_SIZE * 8];
+  unsigned int d, n, c;
+  int x, y;
+
+  while (UntriedNum > 0) {
+    c = Untried[--UntriedNum];
+    L->Cell[Weight] = c;
+
+    if (L->Out[Weight + 1])
+      memcpy(L->Out[Weight + 1] + L->Count[Weight + 1] * (Weight + 1), L->Cell, Weight + 1);
+    L->Count[Weight + 1]++;
+
+    if (Weight + 1 < L->MaxWeight) {
+      memcpy(Next, Untried, UntriedNum);
+      for (n = UntriedNum, d = 0; d < L->Directions; d++) {
+        x = CELL_X(c) + Step[d][0];
+        y = CELL_Y(c) + Step[d][1];
+        if ((y < 0) || ((y == 0) && (x < 0)) || (x < -7) || (x > 7) || (y > 7))
+          continue;
+        if (!L->Reached[CELL(x, y)]) {
+          L->Reached[CELL(x, y)] = 1;
+          Next[n++] = CELL(x, y);
+        }
+      }
+
+      Extend(L, Next, n, Weight + 1);
+
+      while (n > UntriedNum)
+        L->Reached[Next[--n]] = 0;
+    }
+  }
+}
+
+
+static void ListShapes(struct Lister *L) {
+  unsigned char Root = CELL(0, 0);
+
+  memset(L->Count, 0, sizeof(L->Count));
+  memset(L->Reached, 0, sizeof(L->Reached));
+  L->Reached[Root] = 1;
+
+  Extend(L, &Root, 1, 0);
+}
+
+
+static pthread_mutex_t ShapeLock = PTHREAD_MUTEX_INITIALIZER;
+static struct ShapeList Shapes[2][MAX_FIGURE_SIZE + 1];
+static unsigned int Listed[2]; /* up to this weight, lists are never freed */
+
+
+/* NULL if out of memory */
+
+const struct ShapeList *GetShapes(unsigned int Diagonal, unsigned int Weight) {
+  const struct ShapeList *S = NULL;
+  struct Lister L;
+  unsigned int w;
+
+  Diagonal = !!Diagonal;
+
+  pthread_mutex_lock(&ShapeLock);
+
+  if (Listed[Diagonal] >= Weight) {
+    S = Shapes[Diagonal] + Weight;
+  } else {
+    memset(&L, 0, sizeof(L));
+    L.MaxWeight = Weight;
+    L.Directions = Diagonal ? 8 : 4;
+
+    ListShapes(&L);
+
+    for (w = Listed[Diagonal] + 1; w <= Weight; w++) {
+      L.Out[w] = malloc(L.Count[w] * w);
+      if (L.Out[w] == NULL)
+        break;
+    }
+
+    if (w > Weight) {
+      ListShapes(&L);
+      for (w = Listed[Diagonal] + 1; w <= Weight; w++) {
+        Shapes[Diagonal][w].Num = L.Count[w];
+        Shapes[Diagonal][w].Cell = L.Out[w];
+      }
+      Listed[Diagonal] = Weight;
+      S = Shapes[Diagonal] + Weight;
+    } else {
+      for (w = Listed[Diagonal] + 1; w <= Weight; w++)
+        free(L.Out[w]);
+    }
+  }
+
+  pthread_mutex_unlock(&ShapeLock);
+
+  return S;
+}
+
+
+void ShapeFigure(const struct ShapeList *L, unsigned int Weight, unsigned int Index, struct Coord *F) {
+  const unsigned char *C = L->Cell + Index * Weight;
+  unsigned int i;
+
+  for (i = 0; i < Weight; i++) {
+    F[i].x = CELL_X(C[i]);
+    F[i].y = CELL_Y(C[i]);
+  }
+}
+
@@ -0,0 +1,16 @@
+#ifndef _OMNISHAPE_H
+
+#define _OMNISHAPE_H 1
+
+#include "omnitype.h"
+
+struct ShapeList {             /* fixed figures of one weight */
+  unsigned int Num;
+  unsigned char *Cell;         /* Weight cells per figure */
+};
+
+const struct ShapeList *GetShapes(unsigned int Diagonal, unsigned int Weight);
+void ShapeFigure(const struct ShapeList *L, unsigned int Weight, unsigned int Index, struct Coord *F);
+
+#endif
+
@@ -0,0 +1,695 @@
+#define _GNU_SOURCE 1
+
+#include <features.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <pthread.h>
+
+#include "omnifunc.h"
+#include "omnigame.h"
+#include "omnirow.h"
+#include "omnisolve.h"
+
+
+/**************************************
+
+           Placement solver
+
+  Every figure is deployed as in the
+  game and moved by the player's
+  moves only, so each placement found
+  is replayed by GetGlassState. The
+  beam keeps the best glasses after
+  every figure.
+
+**************************************/
+
+struct Placement {
+  struct Coord B[MAX_FIGURE_SIZE];
+};
+
+struct BfsState {          /* blocks are the Index orientation blocks around C */
+  int Index;               /* orientation, see BuildOrientations() */
+  struct Coord C;          /* center */
+};
+
+struct Candidate {
+  struct Placement P;
+  unsigned int Parent;
+  unsigned int Seq;        /* order of discovery within the parent */
+  int Eval;                /* heuristic, less is better */
+  int Score;               /* final score of game over candidate */
+  int Over;
+};
+
+struct BeamNode {
+  unsigned int *Rows;
+  unsigned int GlassHeight;
+  unsigned int GlassLevel;
+  unsigned int EmptyCells;
+};
+
+struct Trace {
+  struct Placement P;
+  unsigned int Parent;
+};
+
+struct HashSlot {
+  unsigned int Gen;
+  unsigned int Index;
+};
+
+struct HashSet {
+  struct HashSlot *Slot;
+  unsigned int Mask;
+  unsigned int Num;
+  unsigned int Gen;
+};
+
+struct SolveWorker {
+  struct Solver *S;
+  struct Omnimino G;       /* scratch game sharing the parameters */
+  unsigned int *Rows;
+  struct OrientTable Turn; /* of the figure being placed */
+  struct BfsState *State;
+  unsigned int StateNum, StateMax;
+  struct HashSet Seen;     /* figure positions */
+  struct HashSet Landed;   /* glass cells taken by the figure */
+  struct FigureMask *Land;
+  struct Candidate *Cand;
+  unsigned int CandNum, CandMax;
+  pthread_t Thread;
+  int Failed;
+};
+
+struct Solver {
+  struct Omnimino *G;
+  unsigned int Beam;
+  unsigned int Jobs;
+  unsigned int RowLen;
+  unsigned int BlockNum;   /* of the current figure */
+  struct Coord **F;        /* current figure */
+  struct BeamNode *Cur, *Next;
+  unsigned int CurNum;
+  unsigned int Take;       /* next parent to expand */
+  pthread_barrier_t Start, Done;
+  int Quit;
+  struct SolveWorker *W;
+};
+
+
+static unsigned int HashWords(const void *Data, unsigned int Len) {
+  const unsigned int *U = Data;
+  unsigned int h = 2166136261u;
+
+  for (; Len > 0; Len--, U++)
+    h = (h ^ *U) * 16777619u;
+
+  return h ^ (h >> 15);
+}
+
+
+static int InitSet(struct HashSet *H, unsigned int Size) {
+  H->Slot = calloc(Size, sizeof(struct HashSlot));
+  H->Mask = Size - 1;
+  H->Num = 0;
+  H->Gen = 1;
+  return H->Slot == NULL;
+}
+
+
+static void ClearSet(struct HashSet *H) {
+  H->Num = 0;
+  if (++H->Gen == 0) {
+    memset(H->Slot, 0, (H->Mask + 1) * sizeof(struct HashSlot));
+    H->Gen = 1;
+  }
+}
+
+
+/* Returns the slot of the equal key or the empty one */
+
+#define FIND_SLOT(H, Hash, Equal) ({ \
+  unsigned int _i = (Hash) & (H)->Mask; \
+  while (((H)->Slot[_i].Gen == (H)->Gen) && !(Equal((H)->Slot[_i].Index))) \
+    _i = (_i + 1) & (H)->Mask; \
+  (H)->Slot + _i; })
+
+
+static int GrowSet(struct HashSet *H, unsigned int (*Hash)(struct SolveWorker *, unsigned int),
+                   struct SolveWorker *W) {
+  struct HashSet New;
+  struct HashSlot *Slot;
+  unsigned int i;
+
+  if (InitSet(&New, (H->Mask + 1) * 2))
+    return 1;
+
+  for (i = 0; i <= H->Mask; i++) {
+    if (H->Slot[i].Gen == H->Gen) {
+      unsigned int j = Hash(W, H->Slot[i].Index) & New.Mask;
+      while (New.Slot[j].Gen == New.Gen)
+        j = (j + 1) & New.Mask;
+      Slot = New.Slot + j;
+      Slot->Gen = New.Gen;
+      Slot->Index = H->Slot[i].Index;
+    }
+  }
+
+  New.Num = H->Num;
+  free(H->Slot);
+  *H = New;
+
+  return 0;
+}
+
+
+/* Orientations with equal blocks give the same positions, the key has the first of them */
+
+#define STATE_KEY_LEN 3
+
+static void GetStateKey(struct SolveWorker *W, struct BfsState *St, unsigned int *Key) {
+  Key[0] = W->Turn.Same[St->Index];
+  Key[1] = St->C.x;
+  Key[2] = St->C.y;
+}
+
+static unsigned int StateHash(struct SolveWorker *W, unsigned int i) {
+  unsigned int Key[STATE_KEY_LEN];
+
+  GetStateKey(W, W->State + i, Key);
+
+  return HashWords(Key, STATE_KEY_LEN);
+}
+
+static unsigned int LandHash(struct SolveWorker *W, unsigned int i) {
+  return HashWords(W->Land + i, sizeof(struct FigureMask) / sizeof(int));
+}
+
+
+/**************************************
+
+         Candidates evaluation
+
+**************************************/
+
+static void LoadNode(struct Omnimino *G, struct BeamNode *N, unsigned int *Rows) {
+  G->V.GlassHeight = N->GlassHeight;
+  G->V.FieldSize = N->GlassHeight + G->C.FigureSize + 1;
+  G->V.GlassLevel = N->GlassLevel;
+  G->V.EmptyCells = N->EmptyCells;
+  G->V.GameOver = 0;
+  G->V.GoalReached = 0;
+  G->M.GlassRow = Rows;
+  G->V.SkylineValid = 0;
+}
+
+
+/* The glass rows start above N->Rows after discarding full rows */
+
+static void StoreNode(struct Omnimino *G, struct BeamNode *N) {
+  if (G->M.GlassRow != N->Rows)
+    memmove(N->Rows, G->M.GlassRow, G->V.FieldSize * G->C.RowWords * sizeof(int));
+  N->GlassHeight = G->V.GlassHeight;
+  N->GlassLevel = G->V.GlassLevel;
+  N->EmptyCells = G->V.EmptyCells;
+}
+
+
+/* Covered empty cells weigh most, then the glass level */
+
+static int Evaluate(struct Omnimino *G) {
+  unsigned int r, Covered[MAX_ROW_WORDS] = {0}, Holes = 0;
+  unsigned int *Row = G->M.GlassRow, Words = G->C.RowWords;
+  int Eval;
+
+  for (r = G->V.GlassLevel; r-- > 0;)
+    Holes += RowCover(Covered, Row + r * Words, Words);
+
+  Eval = G->V.EmptyCells + 4 * Holes + 2 * G->V.GlassLevel;
+
+  if ((G->P.Goal == FLAT_GOAL) && (G->V.GlassLevel > 0)) /* top row gaps */
+    Eval += 4 * (G->P.GlassWidth - RowCount(Row + (G->V.GlassLevel - 1) * Words, Words));
+
+  return Eval;
+}
+
+
+static int PushCandidate(struct SolveWorker *W, struct Placement *P, unsigned int Parent, unsigned int Seq) {
+  struct Candidate *C;
+
+  if (W->CandNum == W->CandMax) {
+    unsigned int NewMax = W->CandMax ? W->CandMax * 2 : 1024;
+    C = realloc(W->Cand, NewMax * sizeof(struct Candidate));
+    if (C == NULL)
+      return 1;
+    W->Cand = C;
+    W->CandMax = NewMax;
+  }
+
+  C = W->Cand + W->CandNum++;
+  C->P = *P;
+  C->Parent = Parent;
+  C->Seq = Seq;
+  C->Over = W->G.V.GameOver;
+  C->Eval = Evaluate(&W->G);
+  C->Score = GetScore(&W->G);
+
+  return 0;
+}
+
+
+static int PushState(struct SolveWorker *W, struct BfsState *St) {
+  struct HashSlot *Slot;
+  unsigned int Key[STATE_KEY_LEN];
+
+  GetStateKey(W, St, Key);
+
+#define SAME_STATE(i) ((W->Turn.Same[W->State[i].Index] == Key[0]) && \
+                       (W->State[i].C.x == St->C.x) && (W->State[i].C.y == St->C.y))
+
+  Slot = FIND_SLOT(&W->Seen, HashWords(Key, STATE_KEY_LEN), SAME_STATE);
+  if (Slot->Gen == W->Seen.Gen)
+    return 0;
+
+  if (W->StateNum == W->StateMax) {
+    unsigned int NewMax = W->StateMax * 2;
+    struct BfsState *NewState = realloc(W->State, NewMax * sizeof(struct BfsState));
+    if (NewState == NULL)
+      return 1;
+    W->State = NewState;
+    W->StateMax = NewMax;
+  }
+
+  Slot->Gen = W->Seen.Gen;
+  Slot->Index = W->StateNum;
+  W->State[W->StateNum++] = *St;
+
+  if ((++W->Seen.Num * 2) > W->Seen.Mask)
+    return GrowSet(&W->Seen, StateHash, W);
+
+  return 0;
+}
+
+
+/* The same landing may be reached from many positions */
+
+static int NewLanding(struct SolveWorker *W, struct FigureMask *M) {
+  struct HashSlot *Slot;
+  unsigned int Len = sizeof(struct FigureMask) / sizeof(int);
+
+#define SAME_LANDING(i) (memcmp(W->Land + i, M, sizeof(struct FigureMask)) == 0)
+
+  Slot = FIND_SLOT(&W->Landed, HashWords(M, Len), SAME_LANDING);
+  if (Slot->Gen == W->Landed.Gen)
+    return 0;
+
+  Slot->Gen = W->Landed.Gen;
+  Slot->Index = W->Landed.Num;
+  W->Land[W->Landed.Num] = *M;
+
+  if ((++W->Landed.Num * 2) > W->Landed.Mask) { /* Land keeps Mask + 1 entries */
+    struct FigureMask *NewLand = realloc(W->Land, (W->Landed.Mask + 1) * 2 * sizeof(struct FigureMask));
+    if (NewLand == NULL) {
+      W->Failed = 1;
+    } else {
+      W->Land = NewLand;
+      W->Failed = GrowSet(&W->Landed, LandHash, W);
+    }
+  }
+
+  return 1;
+}
+
+
+static struct Move {
+  int Turn;                /* MAX_TURN for shifts */
+  int dx, dy;
+  int Vertical;
+} MoveList[] = {
+  {MAX_TURN, -2,  0, 0},
+  {MAX_TURN,  2,  0, 0},
+  {MAX_TURN,  0, -2, 1},
+  {MAX_TURN,  0,  2, 1},
+  {TURN_CW,     0, 0, 0},
+  {TURN_CCW,    0, 0, 0},
+  {TURN_MIRROR, 0, 0, 0},
+  {-1, 0, 0, 0}
+};
+
+
+static void Expand(struct SolveWorker *W, unsigned int Parent) {
+  struct Solver *S = W->S;
+  struct Omnimino *G = &(W->G);
+  struct BeamNode *N = S->Cur + Parent;
+  struct BfsState P, Q;
+  struct Placement Pl;
+  struct Coord *FP[2];
+  struct FigureMask M;
+  struct Move *Mv;
+  unsigned int i, Seq = 0;
+
+  LoadNode(G, N, N->Rows);
+
+  ClearSet(&W->Seen);
+  ClearSet(&W->Landed);
+  W->StateNum = 0;
+
+  memcpy(Pl.B, S->F[0], S->BlockNum * sizeof(struct Coord));
+  FP[0] = Pl.B;
+  FP[1] = Pl.B + S->BlockNum;
+  Deploy(G, FP);
+  BuildOrientations(FP, &(W->Turn));
+  P.Index = W->Turn.Index;
+  P.C = W->Turn.C;
+
+  if (PushState(W, &P))
+    W->Failed = 1;
+
+  for (i = 0; (i < W->StateNum) && (!W->Failed); i++) {
+    P = W->State[i];
+    OrientMask(&(W->Turn), P.Index, &(P.C), &M);
+
+    if (CanDrop(G, &M)) {
+      Fall(G, &M);
+      if (NewLanding(W, &M)) {
+        memcpy(W->Rows, N->Rows, S->RowLen * sizeof(int));
+        G->M.GlassRow = W->Rows;
+        DropFigure(G, &M);
+        PlaceOrientation(&(W->Turn), P.Index, &(P.C), FP);
+        if (PushCandidate(W, &Pl, Parent, Seq++))
+          W->Failed = 1;
+        LoadNode(G, N, N->Rows);
+      }
+    }
+
+    for (Mv = MoveList; Mv->Turn >= 0; Mv++) {
+      if (Mv->Vertical && G->P.Gravity)
+        continue;
+      Q = P;
+      if (Mv->Turn == MAX_TURN) {
+        Q.C.x += Mv->dx;
+        Q.C.y += Mv->dy;
+      } else {
+        W->Turn.Index = P.Index;
+        W->Turn.C = P.C;
+        Q.Index = TurnCenter(&(W->Turn), Mv->Turn, &(Q.C));
+      }
+      OrientMask(&(W->Turn), Q.Index, &(Q.C), &M);
+      if (CanMove(G, &M) && PushState(W, &Q))
+        W->Failed = 1;
+    }
+  }
+}
+
+
+static void ExpandAll(struct SolveWorker *W) {
+  unsigned int p;
+
+  W->CandNum = 0;
+
+  while ((p = __sync_fetch_and_add(&(W->S->Take), 1)) < W->S->CurNum)
+    Expand(W, p);
+}
+
+
+static void *SolveThread(void *Arg) {
+  struct SolveWorker *W = Arg;
+
+  for (;;) {
+    pthread_barrier_wait(&(W->S->Start));
+    if (W->S->Quit)
+      break;
+    ExpandAll(W);
+    pthread_barrier_wait(&(W->S->Done));
+  }
+
+  return NULL;
+}
+
+
+/**************************************
+
+           Beam search
+
+**************************************/
+
+static int CompareCandidates(const void *A, const void *B) {
+  const struct Candidate *a = *(struct Candidate * const *) A;
+  const struct Candidate *b = *(struct Candidate * const *) B;
+
+  if (a->Eval != b->Eval)
+    return (a->Eval < b->Eval) ? -1 : 1;
+  if (a->Parent != b->Parent)
+    return (a->Parent < b->Parent) ? -1 : 1;
+  return (a->Seq < b->Seq) ? -1 : (a->Seq > b->Seq);
+}
+
+
+/* the least score, then the shortest game, then the first by parent and discovery */
+
+static int BetterEnd(const struct Candidate *C, unsigned int Depth, const struct Candidate *Best,
+                     unsigned int BestDepth) {
+  if (BestDepth == 0)
+    return 1;
+  if (C->Score != Best->Score)
+    return C->Score < Best->Score;
+  if (Depth != BestDepth)
+    return Depth < BestDepth;
+  if (C->Parent != Best->Parent)
+    return C->Parent < Best->Parent;
+  return C->Seq < Best->Seq;
+}
+
+
+static int InitWorker(struct Solver *S, struct SolveWorker *W) {
+  memset(W, 0, sizeof(struct SolveWorker));
+  W->S = S;
+  W->G.P = S->G->P;
+  W->G.C = S->G->C;
+  W->StateMax = 1024;
+  W->State = malloc(W->StateMax * sizeof(struct BfsState));
+  W->Land = malloc(2048 * sizeof(struct FigureMask));
+  W->Rows = calloc(S->RowLen, sizeof(int));
+
+  return (W->State == NULL) || (W->Land == NULL) || (W->Rows == NULL) ||
+         InitSet(&W->Seen, 2048) || InitSet(&W->Landed, 2048);
+}
+
+
+static void FreeWorker(struct SolveWorker *W) {
+  free(W->State);
+  free(W->Land);
+  free(W->Rows);
+  free(W->Cand);
+  free(W->Seen.Slot);
+  free(W->Landed.Slot);
+}
+
+
+int SolveGame(struct Omnimino *G, unsigned int Beam, unsigned int Jobs) {
+  struct Solver S;
+  struct Trace *Trace = NULL, *T;
+  struct Candidate **Sorted = NULL, *C, Best;
+  struct BeamNode *Nodes = NULL, *Swap;
+  struct Coord **First;
+  unsigned int *RowBuf = NULL;
+  unsigned int i, j, d, Depth, BestDepth = 0, CandNum, Started = 1;
+  int Err = 1;
+
+  if (Jobs == 0) {
+    long N = sysconf(_SC_NPROCESSORS_ONLN);
+    Jobs = (N > 0) ? N : 1;
+  }
+  if (Beam == 0)
+    Beam = 1;
+
+  G->V.CurFigure = G->D.NextFigure + 1; /* forces RewindGlassState() */
+  GetGlassState(G);
+
+  First = G->D.NextFigure;
+  Depth = G->D.LastFigure - First;
+
+  memset(&S, 0, sizeof(S));
+  S.G = G;
+  S.Beam = Beam;
+  S.Jobs = Jobs;
+  S.RowLen = (G->P.GlassHeightBuf + G->C.FigureSize + 1) * G->C.RowWords;
+
+  memset(&Best, 0, sizeof(Best));
+  Best.Score = INT_MAX;
+
+  if (G->V.GameOver || (Depth == 0)) {
+    snprintf(G->S.MsgBuf, OM_STRLEN, "Nothing to solve.");
+    return 1;
+  }
+
+  S.Cur = Nodes = calloc(2 * Beam, sizeof(struct BeamNode));
+  S.W = calloc(Jobs, sizeof(struct SolveWorker));
+  RowBuf = calloc((size_t) 2 * Beam * S.RowLen, sizeof(int));
+  Trace = malloc((size_t) Depth * Beam * sizeof(struct Trace));
+
+  if ((S.Cur == NULL) || (S.W == NULL) || (RowBuf == NULL) || (Trace == NULL)) {
+    snprintf(G->S.MsgBuf, OM_STRLEN, "Failed to allocate solver buffers.");
+    goto Exit;
+  }
+
+  S.Next = S.Cur + Beam;
+  for (i = 0; i < 2 * Beam; i++)
+    S.Cur[i].Rows = RowBuf + (size_t) i * S.RowLen;
+
+  StoreNode(G, S.Cur);
+  S.CurNum = 1;
+
+  for (i = 0; i < Jobs; i++) {
+    if (InitWorker(&S, S.W + i)) {
+      Jobs = i + 1;
+      snprintf(G->S.MsgBuf, OM_STRLEN, "Failed to allocate solver buffers.");
+      goto Free;
+    }
+  }
+
+  pthread_barrier_init(&S.Start, NULL, Jobs);
+  pthread_barrier_init(&S.Done, NULL, Jobs);
+
+  for (; Started < Jobs; Started++) {
+    if (pthread_create(&(S.W[Started].Thread), NULL, SolveThread, S.W + Started) != 0)
+      break;
+  }
+
+  if (Started < Jobs) { /* barriers count all the workers */
+    S.Quit = 1;
+    pthread_barrier_wait(&S.Start);
+    for (i = 1; i < Started; i++)
+      pthread_join(S.W[i].Thread, NULL);
+    snprintf(G->S.MsgBuf, OM_STRLEN, "Failed to start solver threads.");
+    goto Destroy;
+  }
+
+  for (d = 0; (d < Depth) && (S.CurNum > 0); d++) {
+    S.F = First + d;
+    S.BlockNum = S.F[1] - S.F[0];
+    S.Take = 0;
+
+    pthread_barrier_wait(&S.Start);
+    ExpandAll(S.W);
+    pthread_barrier_wait(&S.Done);
+
+    for (i = 0, CandNum = 0; i < Jobs; i++) {
+      if (S.W[i].Failed) {
+        snprintf(G->S.MsgBuf, OM_STRLEN, "Failed to allocate solver buffers.");
+        goto Stop;
+      }
+      CandNum += S.W[i].CandNum;
+    }
+
+    free(Sorted);
+    Sorted = malloc((CandNum + 1) * sizeof(struct Candidate *));
+    if (Sorted == NULL) {
+      snprintf(G->S.MsgBuf, OM_STRLEN, "Failed to allocate solver buffers.");
+      goto Stop;
+    }
+
+    for (i = 0, CandNum = 0; i < Jobs; i++) {
+      for (j = 0, C = S.W[i].Cand; j < S.W[i].CandNum; j++, C++) {
+        if (C->Over) {
+          if (BetterEnd(C, d + 1, &Best, BestDepth)) { /* same for any worker order */
+            Best = *C;
+            BestDepth = d + 1;
+          }
+        } else {
+          Sorted[CandNum++] = C;
+        }
+      }
+    }
+
+    qsort(Sorted, CandNum, sizeof(struct Candidate *), CompareCandidates);
+
+    if (CandNum > Beam)
+      CandNum = Beam;
+
+    for (i = 0; i < CandNum; i++) {
+      struct FigureMask M;
+      struct Coord *FP[2];
+
+      C = Sorted[i];
+      T = Trace + (size_t) d * Beam + i;
+      T->P = C->P;
+      T->Parent = C->Parent;
+
+      memcpy(S.Next[i].Rows, S.Cur[C->Parent].Rows, S.RowLen * sizeof(int));
+      LoadNode(&(S.W[0].G), S.Cur + C->Parent, S.Next[i].Rows);
+      FP[0] = C->P.B;
+      FP[1] = C->P.B + S.BlockNum;
+      GetMask(FP, &M);
+      DropFigure(&(S.W[0].G), &M);
+      StoreNode(&(S.W[0].G), S.Next + i);
+
+      if ((d + 1 == Depth) && BetterEnd(C, d + 1, &Best, BestDepth)) {
+        Best = *C;
+        BestDepth = d + 1;
+      }
+    }
+
+    Swap = S.Cur;
+    S.Cur = S.Next;
+    S.Next = Swap;
+    S.CurNum = CandNum;
+  }
+
+  if (BestDepth == 0) {
+    snprintf(G->S.MsgBuf, OM_STRLEN, "No placement found.");
+    goto Stop;
+  }
+
+  /* Best placement of the last figure, then back along the trace */
+
+  d = BestDepth - 1;
+  memcpy(First[d], Best.P.B, (First[d + 1] - First[d]) * sizeof(struct Coord));
+  for (j = Best.Parent; d-- > 0; j = T->Parent) {
+    T = Trace + (size_t) d * Beam + j;
+    memcpy(First[d], T->P.B, (First[d + 1] - First[d]) * sizeof(struct Coord));
+  }
+
+  G->D.NextFigure = First + BestDepth;
+  G->V.LastTouched = G->D.NextFigure - 1;
+  G->V.CheckpointNum = 0;
+  G->V.CurFigure = G->D.NextFigure + 1;
+  G->V.GameModified = 1;
+  GetGlassState(G);
+
+  if (GetScore(G) != Best.Score) {
+    snprintf(G->S.MsgBuf, OM_STRLEN, "Solution replay gives %d instead of %d.", GetScore(G), Best.Score);
+    goto Stop;
+  }
+
+  Err = 0;
+
+Stop:
+  S.Quit = 1;
+  pthread_barrier_wait(&S.Start);
+  for (i = 1; i < Jobs; i++)
+    pthread_join(S.W[i].Thread, NULL);
+
+Destroy:
+  pthread_barrier_destroy(&S.Start);
+  pthread_barrier_destroy(&S.Done);
+
+Free:
+  for (i = 0; i < Jobs; i++)
+    FreeWorker(S.W + i);
+
+Exit:
+  free(Sorted);
+  free(Trace);
+  free(RowBuf);
+  free(S.W);
+  free(Nodes);
+
+  return Err;
+}
+
@@ -0,0 +1,10 @@
+#ifndef _OMNISOLVE_H
+
+#define _OMNISOLVE_H 1
+
+#include "omnitype.h"
+
+int SolveGame(struct Omnimino *G, unsigned int Beam, unsigned int Jobs);
+
+#endif
+
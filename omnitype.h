@@ -3,6 +3,7 @@
 #define _OMNITYPE_H 1
 
 #include <stdlib.h>
+#include <stddef.h>
 
 /**************************************
 
@@ -12,9 +13,14 @@
 
 #define MAX_FIGURE_SIZE 8
 
-#define MAX_GLASS_WIDTH 32 /*UINT_WIDTH*/
+#define MAX_GLASS_WIDTH 256
+
+#define ROW_BITS 32 /* glass row is an array of unsigned int words */
+#define MAX_ROW_WORDS (MAX_GLASS_WIDTH / ROW_BITS)
 #define MAX_GLASS_HEIGHT 256
 
+#define CHECKPOINT_STEP 16 /* figures between saved glass states */
+
 enum GoalTypes {
   FILL_GOAL,
   TOUCH_GOAL,
@@ -34,6 +40,37 @@ struct Coord {
 
 typedef void (*bfunc) (struct Coord *, int *);
 
+#if MAX_FIGURE_SIZE > 8
+#error "figure mask is 8 x 8 bits"
+#endif
+
+struct FigureMask {
+  int Left, Bottom;            /* glass cell of the Bits bit 0 */
+  unsigned int Width, Height;
+  unsigned long long Bits;     /* row i is byte i, column j is bit j of it */
+};
+
+enum Turns {
+  TURN_CW,
+  TURN_CCW,
+  TURN_MIRROR,
+  MAX_TURN
+};
+
+#define ORIENT_NUM 8 /* 4 rotations x mirror */
+
+struct OrientTable {           /* orientations of the figure being played */
+  int N;                       /* blocks */
+  int Index;                   /* current orientation */
+  struct Coord C;              /* current center */
+  struct Coord K[ORIENT_NUM];  /* centers of the turned source figure */
+  struct Coord B[ORIENT_NUM][MAX_FIGURE_SIZE]; /* normalized */
+  struct Coord Min[ORIENT_NUM];   /* lowest B x and y */
+  unsigned long long Bits[ORIENT_NUM]; /* as FigureMask */
+  unsigned char Width[ORIENT_NUM], Height[ORIENT_NUM];
+  unsigned char Same[ORIENT_NUM];  /* first orientation with equal B */
+};
+
 struct OmniParms {
   unsigned int Aperture;
   unsigned int Metric; /* 0 - abs(x1-x0)+abs(y1-y0), 1 - max(abs(x1-x0),abs(y1-y0)) */
@@ -56,7 +93,8 @@ struct OmniParms {
 struct OmniConsts {              /* Parameters' derivatives */
   unsigned int FigureSize;
   unsigned int TotalArea;
-  unsigned int FullRow;
+  unsigned int RowWords;         /* words per glass row */
+  unsigned int FullRow[MAX_ROW_WORDS];
 };
 
 
@@ -64,30 +102,54 @@ struct OmniData {
   struct Coord **LastFigure;
   struct Coord **NextFigure; /* used to navigate through figures */
   unsigned int TimeStamp;
+  unsigned long long Seed;   /* of the figures, 0 - unknown */
+  unsigned int Generator;    /* of the figures */
 };
 
+#define FIGURES_GROWN   0  /* block by block */
+#define FIGURES_UNIFORM 1  /* from the catalogue, see omnishape.c */
+
 struct OmniVars {
   struct Coord **CurFigure;
   struct Coord **LastTouched; /* latest modified */
   struct Coord **FigureBuf;
   unsigned int GameType;
+  unsigned int RecordFormat; /* as loaded, kept on save */
   unsigned int GlassHeight; /* can change during game if DiscardFullRows */
   unsigned int FieldSize;   /* follows GlassHeight with FigureSize + 1 bias */
   unsigned int GlassLevel; /* lowest free line */
   unsigned int EmptyCells;
+  unsigned int CheckpointNum; /* valid saved glass states */
+  unsigned int QueueLen;    /* figures cycled by skipping, 0 - Figure[] is in order */
+  unsigned int QueueShift;  /* the one shown as CurFigure */
   int GameOver;
   int GoalReached;
   int GameModified;
+  int KeepPlaying;
+  int SkylineValid;         /* reset wherever GlassRow is reloaded */
+  unsigned int Skyline[MAX_GLASS_WIDTH]; /* column heights */
+  unsigned long long RandomState[4]; /* figures generator, seeded by NewGame */
+  struct OrientTable Orient;
 };
 
 
 struct OmniMem {
-  unsigned int FillBuf[MAX_GLASS_HEIGHT];
+  unsigned int FillBuf[MAX_GLASS_HEIGHT * MAX_ROW_WORDS];
   size_t GameBufSize;
   struct Coord **Figure;
+  unsigned int *QueueStart;     /* cycled figures, relative to QueueBlock */
+  struct Coord *QueueBlock;
   struct Coord *Block;
-  unsigned int *GlassRow;       /* used by SaveGame too */
+  unsigned int *Checkpoint;
+  unsigned int *GlassBuf;       /* used by SaveGame too */
+  unsigned int *GlassRow;       /* RowWords per row, moves up GlassBuf as rows are discarded */
   size_t StoreBufSize;
+  char *LoadPtr;
+  char *LoadEnd;
+  char *HashedPtr;              /* text records are hashed up to here as they are read */
+  struct md5 *LoadHash;         /* NULL - not hashed */
+  char *StorePtr;
+  int StoreFree;
 };
 
 
@@ -100,6 +162,45 @@ struct OmniStrings {
   char PlayerName[OM_STRLEN + 1];
 };
 
+/**************************************
+
+        Binary record header
+
+  followed by FillNum glass rows,
+  FigureNum + 1 figure offsets (none
+  for presets) and BlockNum x,y pairs
+  of short. Host byte order. Version 1
+  headers end before FigureSeed, 2 -
+  before FigureSource.
+
+**************************************/
+
+#define BIN_MAGIC "OMNB"
+#define BIN_VERSION 3
+
+#define FORMAT_TEXT   0
+#define FORMAT_BINARY 1
+
+struct OmniBinHeader {
+  char Magic[4];
+  unsigned int Version;
+  char Hash[32];            /* md5 of the record past Hash, the record name */
+  unsigned int Parms[PARNUM];
+  unsigned int FillNum;
+  unsigned int FigureNum;
+  unsigned int NextNum;
+  unsigned int BlockNum;
+  unsigned int Stamp;
+  char Parent[OM_STRLEN + 4];
+  char Player[OM_STRLEN + 4];
+  unsigned long long FigureSeed;
+  unsigned int FigureSource;
+  unsigned int Reserved;
+};
+
+#define BIN_HASHED_PART offsetof(struct OmniBinHeader, Parms)
+
+
 struct Omnimino {
   struct OmniParms   P;
   struct OmniConsts  C;